@@ -0,0 +1,83 @@
+#version 330 core
+
+// Vertex attributes of a compact_vertex. The direction and the normal are 
+// octahedral encoded and not normalized by OpenGL, the height is normalized to
+// [0, 1].
+
+layout (location = 0) in vec2 attribute_direction;
+
+layout (location = 1) in vec4 attribute_color;
+
+layout (location = 2) in vec2 attribute_normal;
+
+layout (location = 3) in float attribute_height;
+
+// Input matrices.
+
+uniform mat4 matrix_projection;
+
+uniform mat4 matrix_view;
+
+uniform mat4 matrix_model;
+
+// The height above the unit sphere of a vertex whose attribute_height is 1.
+
+uniform float height_range;
+
+// Output to the fragment shader.
+
+out vec3 position_attribute;
+
+out vec3 color_attribute;
+
+out vec3 normal_attribute;
+
+out vec3 light;
+
+// Decode a unit vector from a point in the square [-1, 1] x [-1, 1], by 
+// folding the square back into an octahedron.
+
+vec3 decode_octahedral(vec2 encoded)
+{
+	vec3 vector = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+
+	float fold = max(-vector.z, 0.0f);
+
+	vector.x += vector.x >= 0.0f ? -fold : fold;
+	vector.y += vector.y >= 0.0f ? -fold : fold;
+
+	return normalize(vector);
+}
+
+// Main shader code.
+
+void main()
+{
+	mat3 normal_matrix = mat3(matrix_model);
+
+	// Decode the position from the direction and the height.
+
+	vec3 direction = decode_octahedral(clamp(attribute_direction / 32767.0f, -1.0f, 1.0f));
+
+	vec3 position = direction * (1.0f + attribute_height * height_range);
+
+	// Multiply the vertex position by the projection, view, and model 
+	// matrices to find the final position.
+
+	gl_Position = matrix_projection * matrix_view * matrix_model * vec4(position, 1.0f);
+
+	// Pass the position attribute, color attribute, and normal attribute to
+	// the fragment shader.
+
+	position_attribute = position;
+
+	color_attribute = attribute_color.rgb;
+
+	normal_attribute = decode_octahedral(clamp(attribute_normal / 127.0f, -1.0f, 1.0f));
+
+	// Rotate the light's direction to ensure that the light is always facing
+	// from the camera towards the planet. Pass the light direction to the 
+	// fragment shader.
+
+	light = normalize(vec3(0.0f, 0.0f, 1.0f) * normal_matrix);
+}
@@ -8,6 +8,11 @@ layout (location = 1) in vec3 attribute_color;
 
 layout (location = 2) in vec3 attribute_normal;
 
+// The height of the surface one level of detail lower at this vertex, minus
+// the height of the vertex. Only used when morph_range is set.
+
+layout (location = 3) in float attribute_morph_height;
+
 // Input matrices.
 
 uniform mat4 matrix_projection;
@@ -16,6 +21,12 @@ uniform mat4 matrix_view;
 
 uniform mat4 matrix_model;
 
+// The distances from the camera at which the vertex starts and finishes 
+// morphing by attribute_morph_height. Morphing is disabled when the 
+// second distance is 0.
+
+uniform vec2 morph_range;
+
 // Output to the fragment shader.
 
 out vec3 position_attribute;
@@ -32,15 +43,31 @@ void main()
 {
 	mat3 normal_matrix = mat3(matrix_model);
 
-	// Multiply the vertex position attribute by the projection, view, and
-	// model matrices to find the final position.
+	// Morph the vertex along its direction from the center of the planet 
+	// towards the height of the surface one level of detail lower, based on 
+	// the distance to the camera. Vertices that also exist one level lower 
+	// have a morph height of exactly 0, so they stay exactly where they are.
+
+	vec3 position = attribute_position;
+
+	if (morph_range.y > 0.0f)
+	{
+		float distance = length((matrix_view * matrix_model * vec4(attribute_position, 1.0f)).xyz);
+
+		float morph = clamp((distance - morph_range.x) / max(morph_range.y - morph_range.x, 1e-6f), 0.0f, 1.0f);
+
+		position += normalize(attribute_position) * (attribute_morph_height * morph);
+	}
+
+	// Multiply the vertex position by the projection, view, and model 
+	// matrices to find the final position.
 
-	gl_Position = matrix_projection * matrix_view * matrix_model * vec4(attribute_position, 1.0f);
+	gl_Position = matrix_projection * matrix_view * matrix_model * vec4(position, 1.0f);
 
 	// Pass the position attribute, color attribute, and normal attribute to
 	// the fragment shader.
 
-	position_attribute = attribute_position;
+	position_attribute = position;
 
 	color_attribute = attribute_color;
 
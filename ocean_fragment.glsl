@@ -0,0 +1,85 @@
+#version 330 core
+
+// Input from the vertex shader.
+
+in vec3 position_attribute;
+
+in vec3 light;
+
+// Input matrices.
+
+uniform mat4 matrix_projection;
+
+uniform mat4 matrix_view;
+
+uniform mat4 matrix_model;
+
+// The position of the camera in model space.
+
+uniform vec3 camera_position;
+
+// The colors of the ocean, as an equirectangular image (see 
+// create_ocean_colors).
+
+uniform sampler2D ocean_colors;
+
+// Output to OpenGL.
+
+out vec4 fragment_color;
+
+// Shader code.
+
+void main()
+{
+	// Intersect the ray from the camera through the fragment with the unit 
+	// sphere, which is the surface of the ocean.
+
+	vec3 direction = normalize(position_attribute - camera_position);
+
+	float b = dot(camera_position, direction);
+
+	float discriminant = b * b - (dot(camera_position, camera_position) - 1.0f);
+
+	if (discriminant < 0.0f)
+	{
+		discard;
+	}
+
+	float distance = -b - sqrt(discriminant);
+
+	if (distance < 0.0f)
+	{
+		discard;
+	}
+
+	// The position on the unit sphere is also its normal.
+
+	vec3 normal = camera_position + direction * distance;
+
+	// Write the depth of the ocean's surface instead of the depth of the 
+	// cube, unless it is in front of the near plane.
+
+	vec4 clip_position = matrix_projection * matrix_view * matrix_model * vec4(normal, 1.0f);
+
+	if (clip_position.z < -clip_position.w)
+	{
+		discard;
+	}
+
+	gl_FragDepth = (clip_position.z / clip_position.w) * 0.5f + 0.5f;
+
+	// Look up the color of the ocean at the position.
+
+	vec2 coordinates = vec2(atan(normal.z, normal.x) / 6.28318531f + 0.5f, asin(clamp(normal.y, -1.0f, 1.0f)) / 3.14159265f + 0.5f);
+
+	vec3 color_attribute = texture(ocean_colors, coordinates).rgb;
+
+	// Calculate the light's intensity.
+
+	float intensity = dot(light, normal);
+
+	// Pass the ocean's color to OpenGL, after calculating diffuse and 
+	// specular lighting.
+
+	fragment_color = vec4(color_attribute + (vec3(1.0f, 1.0f, 1.0f) * pow(intensity, 50.0f)), 1.0f) * intensity;
+}
@@ -0,0 +1,42 @@
+#version 330 core
+
+// Vertex attributes. The ocean is drawn with the back faces of a cube around
+// the planet, and ocean_fragment.glsl finds the surface of the ocean itself.
+
+layout (location = 0) in vec3 attribute_position;
+
+// Input matrices.
+
+uniform mat4 matrix_projection;
+
+uniform mat4 matrix_view;
+
+uniform mat4 matrix_model;
+
+// Output to the fragment shader.
+
+out vec3 position_attribute;
+
+out vec3 light;
+
+// Main shader code.
+
+void main()
+{
+	mat3 normal_matrix = mat3(matrix_model);
+
+	// Multiply the vertex position by the projection, view, and model 
+	// matrices to find the final position.
+
+	gl_Position = matrix_projection * matrix_view * matrix_model * vec4(attribute_position, 1.0f);
+
+	// Pass the position attribute to the fragment shader.
+
+	position_attribute = attribute_position;
+
+	// Rotate the light's direction to ensure that the light is always facing
+	// from the camera towards the planet. Pass the light direction to the 
+	// fragment shader.
+
+	light = normalize(vec3(0.0f, 0.0f, 1.0f) * normal_matrix);
+}
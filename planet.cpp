@@ -5,6 +5,7 @@ results. Previous versions of GLM are not guaranteed to work correctly.
 
 */
 
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
@@ -60,553 +61,8431 @@ Standard header include directives.
 #include <string>
 #include <vector>
 #include <tuple>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <map>
+#include <type_traits>
+#include <typeinfo>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
 
 /*
 
-A std::tuple<int, int, int> is used to represent a triangle defined by indices
-in a list of vertices.
+x86 SIMD intrinsics. The batched noise kernels are compiled for AVX2 and 
+AVX-512 through function attributes and chosen at runtime, so the rest of the
+program does not need those instruction sets. Other compilers and platforms 
+evaluate the noise modules one point at a time.
 
 */
 
-typedef std::tuple<int, int, int> triangle_indices;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define PLANET_NOISE_SIMD
+
+#include <immintrin.h>
+
+#endif
 
 /*
 
-Add a vertex to a std::vector<glm::vec3> while ensuring that the vertex lies
-on the unit sphere.
+POSIX header include directives. mmap is used to map cached planets straight
+into memory. Other platforms fall back to reading the whole file.
 
 */
 
-int add_vertex(std::vector<glm::vec3>& vector, glm::vec3 vertex)
-{
-	vector.push_back(vertex / glm::length(vertex));
+#ifndef _WIN32
 
-	return vector.size() - 1;
-}
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#endif
 
 /*
 
-Return the index of a vertex in the middle of p_1 and p_2.
+A thread_pool runs the blocks of a parallel loop on a fixed set of worker
+threads. The thread that calls parallel_for works on blocks too, and only
+returns once every block has been processed. Blocks may run in any order, so
+loop bodies must only write to memory that belongs to their own block.
 
 */
 
-int get_middle_point(std::vector<glm::vec3>& vector, int p_1, int p_2)
+class thread_pool
 {
-	glm::vec3 pt_1 = vector[p_1];
-	glm::vec3 pt_2 = vector[p_2];
-
-	glm::vec3 pt_middle = (pt_1 + pt_2) / 2.0f;
+public:
 
-	int i = add_vertex(vector, pt_middle);
+	// Create a thread_pool that runs loops on thread_count threads, including
+	// the thread that calls parallel_for.
 
-	return i;
-}
+	thread_pool(unsigned int thread_count)
+	{
+		job_body = NULL;
 
-/*
+		job_count = 0;
 
-Create an icosphere with the given amount of subdivisions.
+		job_block_size = 1;
 
-*/
+		job_next = 0;
 
-std::vector<glm::vec3> create_icosphere(int subdivisions = 8)
-{ 
-	// Generate the icosphere's vertices.
+		job_generation = 0;
 
-	std::vector<glm::vec3> icosphere_vertices;
+		job_active = 0;
 
-	// Generate the 12 vertices of an icosahedron.
+		stopping = false;
 
-	float t = (1.0f + sqrt(5.0f)) / 2.0f;
+		for (unsigned int i = 1; i < thread_count; i++)
+		{
+			workers.push_back(std::thread(&thread_pool::work, this));
+		}
+	}
 
-	add_vertex(icosphere_vertices, glm::vec3(-1.0f,  t, 0.0f));
-	add_vertex(icosphere_vertices, glm::vec3( 1.0f,  t, 0.0f));
-	add_vertex(icosphere_vertices, glm::vec3(-1.0f, -t, 0.0f));
-	add_vertex(icosphere_vertices, glm::vec3( 1.0f, -t, 0.0f));
+	// Stop and join every worker thread.
 
-	add_vertex(icosphere_vertices, glm::vec3(0.0f, -1.0f,  t));
-	add_vertex(icosphere_vertices, glm::vec3(0.0f,  1.0f,  t));
-	add_vertex(icosphere_vertices, glm::vec3(0.0f, -1.0f, -t));
-	add_vertex(icosphere_vertices, glm::vec3(0.0f,  1.0f, -t));
+	~thread_pool()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
 
-	add_vertex(icosphere_vertices, glm::vec3( t, 0.0f, -1.0f));
-	add_vertex(icosphere_vertices, glm::vec3( t, 0.0f,  1.0f));
-	add_vertex(icosphere_vertices, glm::vec3(-t, 0.0f, -1.0f));
-	add_vertex(icosphere_vertices, glm::vec3(-t, 0.0f,  1.0f));
+			stopping = true;
+		}
 
-	// Generate the 20 faces of an icosahedron.
+		job_ready.notify_all();
 
-	std::vector<triangle_indices> icosphere_indices;
+		for (int i = 0; i < workers.size(); i++)
+		{
+			workers[i].join();
+		}
+	}
 
-	icosphere_indices.push_back(triangle_indices(0x0, 0xB, 0x5));
-	icosphere_indices.push_back(triangle_indices(0x0, 0x5, 0x1));
-	icosphere_indices.push_back(triangle_indices(0x0, 0x1, 0x7));
-	icosphere_indices.push_back(triangle_indices(0x0, 0x7, 0xA));
-	icosphere_indices.push_back(triangle_indices(0x0, 0xA, 0xB));
+	// Return the amount of threads that run loops, including the thread that
+	// calls parallel_for.
 
-	icosphere_indices.push_back(triangle_indices(0x1, 0x5, 0x9));
-	icosphere_indices.push_back(triangle_indices(0x5, 0xB, 0x4));
-	icosphere_indices.push_back(triangle_indices(0xB, 0xA, 0x2));
-	icosphere_indices.push_back(triangle_indices(0xA, 0x7, 0x6));
-	icosphere_indices.push_back(triangle_indices(0x7, 0x1, 0x8));
+	unsigned int get_thread_count() const
+	{
+		return workers.size() + 1;
+	}
 
-	icosphere_indices.push_back(triangle_indices(0x3, 0x9, 0x4));
-	icosphere_indices.push_back(triangle_indices(0x3, 0x4, 0x2));
-	icosphere_indices.push_back(triangle_indices(0x3, 0x2, 0x6));
-	icosphere_indices.push_back(triangle_indices(0x3, 0x6, 0x8));
-	icosphere_indices.push_back(triangle_indices(0x3, 0x8, 0x9));
+	// Call body(begin, end) for every block of block_size consecutive indices
+	// in [0, count). parallel_for must not be called from inside a body.
 
-	icosphere_indices.push_back(triangle_indices(0x4, 0x9, 0x5));
-	icosphere_indices.push_back(triangle_indices(0x2, 0x4, 0xB));
-	icosphere_indices.push_back(triangle_indices(0x6, 0x2, 0xA));
-	icosphere_indices.push_back(triangle_indices(0x8, 0x6, 0x7));
-	icosphere_indices.push_back(triangle_indices(0x9, 0x8, 0x1));
+	void parallel_for(size_t count, size_t block_size, const std::function<void(size_t, size_t)>& body)
+	{
+		block_size = std::max(block_size, size_t(1));
 
-	// Subdivide the icosphere.
+		// Run small loops on the calling thread.
 
-	for (int i = 0; i < subdivisions; i++)
-	{
-		// Generate a temporary mesh to hold the result of the next 
-		// subdivision.
+		if (workers.empty() || count <= block_size)
+		{
+			for (size_t begin = 0; begin < count; begin += block_size)
+			{
+				body(begin, std::min(begin + block_size, count));
+			}
 
-		std::vector<triangle_indices> new_icosphere_indices;
+			return;
+		}
 
-		// Subdivide each triangle in the current mesh.
+		// Wait for late workers of the previous loop to leave it, then 
+		// publish the new loop.
 
-		for (int j = 0; j < icosphere_indices.size(); j++)
 		{
-			triangle_indices tri = icosphere_indices[j];
+			std::unique_lock<std::mutex> lock(mutex);
+
+			job_done.wait(lock, [this]() { return job_active == 0; });
 
-			int a = get_middle_point(icosphere_vertices, std::get<0>(tri), std::get<1>(tri));
-			int b = get_middle_point(icosphere_vertices, std::get<1>(tri), std::get<2>(tri));
-			int c = get_middle_point(icosphere_vertices, std::get<2>(tri), std::get<0>(tri));
+			job_body = &body;
 
-			// Add the 4 new triangles to the temporary mesh.
+			job_count = count;
 
-			new_icosphere_indices.push_back(triangle_indices(std::get<0>(tri), a, c));
-			new_icosphere_indices.push_back(triangle_indices(std::get<1>(tri), b, a));
-			new_icosphere_indices.push_back(triangle_indices(std::get<2>(tri), c, b));
+			job_block_size = block_size;
 
-			new_icosphere_indices.push_back(triangle_indices(a, b, c));
+			job_next = 0;
+
+			job_generation++;
 		}
 
-		// Replace the current mesh with the temporary mesh.
+		job_ready.notify_all();
+
+		// Work on the loop, then wait for the workers to finish their last
+		// blocks.
+
+		run_blocks();
+
+		std::unique_lock<std::mutex> lock(mutex);
 
-		icosphere_indices = new_icosphere_indices;
+		job_done.wait(lock, [this]() { return job_active == 0; });
 	}
 
-	// Convert the icosphere's structured triangle_indices vector to a list of
-	// ordered vertices.
+private:
 
-	std::vector<glm::vec3> icosphere_mesh;
+	// Claim and run blocks of the current loop until none are left.
 
-	for (int i = 0; i < icosphere_indices.size(); i++)
+	void run_blocks()
 	{
-		icosphere_mesh.push_back(icosphere_vertices[std::get<0>(icosphere_indices[i])]);
-		icosphere_mesh.push_back(icosphere_vertices[std::get<1>(icosphere_indices[i])]);
-		icosphere_mesh.push_back(icosphere_vertices[std::get<2>(icosphere_indices[i])]);
+		while (true)
+		{
+			size_t begin = job_next.fetch_add(job_block_size);
+
+			if (begin >= job_count)
+			{
+				return;
+			}
+
+			(*job_body)(begin, std::min(begin + job_block_size, job_count));
+		}
 	}
 
-	// Return the icosphere's mesh.
+	// The main function of each worker thread.
 
-	return icosphere_mesh;
+	void work()
+	{
+		size_t seen_generation = 0;
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (true)
+		{
+			job_ready.wait(lock, [&]() { return stopping || job_generation != seen_generation; });
+
+			if (stopping)
+			{
+				return;
+			}
+
+			seen_generation = job_generation;
+
+			job_active++;
+
+			lock.unlock();
+
+			run_blocks();
+
+			lock.lock();
+
+			if (--job_active == 0)
+			{
+				job_done.notify_all();
+			}
+		}
+	}
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+
+	std::condition_variable job_ready;
+	std::condition_variable job_done;
+
+	// The current loop. These are only written while no worker is inside
+	// run_blocks.
+
+	const std::function<void(size_t, size_t)>* job_body;
+
+	size_t job_count;
+
+	size_t job_block_size;
+
+	std::atomic<size_t> job_next;
+
+	// The amount of loops that have been published, and the amount of 
+	// workers that are inside run_blocks.
+
+	size_t job_generation;
+
+	unsigned int job_active;
+
+	bool stopping;
 };
 
 /*
 
-Load a shader program from two files.
+Return the thread_pool that is shared by the whole program. It uses one thread
+per hardware thread.
 
 */
 
-GLuint load_shader_program
-(
-	std::string shader_path_0,
-	std::string shader_path_1,
+thread_pool& get_thread_pool()
+{
+	static thread_pool pool(std::max(std::thread::hardware_concurrency(), 1u));
 
-	GLenum shader_type_0,
-	GLenum shader_type_1
-)
+	return pool;
+}
+
+/*
+
+A std::tuple<int, int, int> is used to represent a triangle defined by indices
+in a list of vertices.
+
+*/
+
+typedef std::tuple<int, int, int> triangle_indices;
+
+/*
+
+Add a vertex to a std::vector<glm::vec3> while ensuring that the vertex lies
+on the unit sphere.
+
+*/
+
+int add_vertex(std::vector<glm::vec3>& vector, glm::vec3 vertex)
 {
-	// Open shader_path_0 and shader_path_1 as input file streams.
+	vector.push_back(vertex / glm::length(vertex));
 
-	std::ifstream shader_file_0(shader_path_0);
-	std::ifstream shader_file_1(shader_path_1);
+	return vector.size() - 1;
+}
 
-	if (!shader_file_0.is_open())
-	{
-		std::cout << "Could not open file \"" << shader_path_0 << "\"." << std::endl;
+/*
 
-		exit(EXIT_FAILURE);
-	}
-	else if (!shader_file_1.is_open())
-	{
-		std::cout << "Could not open file \"" << shader_path_1 << "\"." << std::endl;
+A midpoint_cache maps an edge to the index of the vertex in the middle of that
+edge. Edges are keyed by the (min, max) indices of their endpoints, so both of
+the triangles that share an edge resolve to the same midpoint vertex. The cache
+uses open addressing with linear probing over a power of two sized table, and
+never allocates after it has been created.
 
-		exit(EXIT_FAILURE);
+*/
+
+struct midpoint_cache
+{
+	std::vector<uint64_t> keys;
+
+	std::vector<int> values;
+
+	uint64_t mask;
+};
+
+/*
+
+The key used to mark an empty slot in a midpoint_cache. No edge can produce
+this key, because an edge never connects a vertex to itself.
+
+*/
+
+const uint64_t midpoint_cache_empty = UINT64_MAX;
+
+/*
+
+Create a midpoint_cache that can hold at least edge_count edges while staying
+at most half full.
+
+*/
+
+midpoint_cache create_midpoint_cache(size_t edge_count)
+{
+	size_t capacity = 1;
+
+	while (capacity < edge_count * 2)
+	{
+		capacity *= 2;
 	}
 
-	// Load the text context of shader_path_0 and shader_path_1 into 
-	// shader_buffer_0 and shader_buffer_1.
+	midpoint_cache cache;
 
-	std::stringstream shader_buffer_0;
-	std::stringstream shader_buffer_1;
+	cache.keys.assign(capacity, midpoint_cache_empty);
 
-	shader_buffer_0 << shader_file_0.rdbuf() << "\0";
-	shader_buffer_1 << shader_file_1.rdbuf() << "\0";
+	cache.values.assign(capacity, -1);
 
-	// Convert shader_buffer_0 and shader_buffer_1 from std::stringstream to
-	// std::string, and then to const GLchar* (const char*).
+	cache.mask = capacity - 1;
 
-	std::string shader_text_0 = shader_buffer_0.str();
-	std::string shader_text_1 = shader_buffer_1.str();
+	return cache;
+}
 
-	const GLchar* shader_data_0 = shader_text_0.c_str();
-	const GLchar* shader_data_1 = shader_text_1.c_str();
+/*
 
-	// Create shader_0 and shader_1 with the types shader_type_0 and 
-	// shader_type_1, then source them with shader_data_0 and shader_data_1.
+Remove every edge from a midpoint_cache without releasing its memory.
 
-	GLuint shader_0 = glCreateShader(shader_type_0);
-	GLuint shader_1 = glCreateShader(shader_type_1);
+*/
 
-	glShaderSource(shader_0, 1, &shader_data_0, NULL);
-	glShaderSource(shader_1, 1, &shader_data_1, NULL);
+void clear_midpoint_cache(midpoint_cache& cache)
+{
+	std::fill(cache.keys.begin(), cache.keys.end(), midpoint_cache_empty);
+}
 
-	// Compile shader_0 and shader_1.
+/*
 
-	glCompileShader(shader_0);
-	glCompileShader(shader_1);
+Return the key of the edge between p_1 and p_2, which is the same in both
+directions.
 
-	// Check if shader_0 or shader_1 failed compilation. If so, print out the
-	// error message provided by OpenGL.
+*/
 
-	GLint success_0 = 0;
-	GLint success_1 = 0;
+uint64_t get_edge_key(int p_1, int p_2)
+{
+	uint64_t key_min = std::min(p_1, p_2);
+	uint64_t key_max = std::max(p_1, p_2);
 
-	GLchar crash_information_0[16 * 1024];
-	GLchar crash_information_1[16 * 1024];
+	return (key_min << 32) | key_max;
+}
 
-	glGetShaderiv(shader_0, GL_COMPILE_STATUS, &success_0);
-	glGetShaderiv(shader_1, GL_COMPILE_STATUS, &success_1);
+/*
 
-	if (!success_0)
-	{
-		std::cout << "Could not compile shader loaded from \"" << shader_path_0 << "\"." << std::endl;
+Return the index of a vertex in the middle of p_1 and p_2. The vertex is only
+created (by calling create_midpoint(p_1, p_2)) the first time the edge is 
+seen, every later lookup of the same edge (in either direction) returns the 
+cached index.
 
-		glGetShaderInfoLog(shader_0, 16 * 1024, NULL, crash_information_0);
+*/
 
-		std::cout << crash_information_0;
+template <typename midpoint_function>
+int get_middle_point(midpoint_cache& cache, int p_1, int p_2, midpoint_function& create_midpoint)
+{
+	uint64_t key = get_edge_key(p_1, p_2);
 
-		exit(EXIT_FAILURE);
-	}
-	else if (!success_1)
-	{
-		std::cout << "Could not compile shader loaded from \"" << shader_path_1 << "\"." << std::endl;
+	// Find the slot of the edge, or the empty slot where it belongs.
 
-		glGetShaderInfoLog(shader_1, 16 * 1024, NULL, crash_information_1);
+	uint64_t slot = ((key * 0x9E3779B97F4A7C15ULL) >> 32) & cache.mask;
 
-		std::cout << crash_information_1;
+	while (cache.keys[slot] != midpoint_cache_empty)
+	{
+		if (cache.keys[slot] == key)
+		{
+			return cache.values[slot];
+		}
 
-		exit(EXIT_FAILURE);
+		slot = (slot + 1) & cache.mask;
 	}
 
-	// Create an empty shader program.
+	// The edge has not been seen yet, so create its midpoint.
 
-	GLuint shader_program = glCreateProgram();
+	int i = create_midpoint(p_1, p_2);
 
-	// Attach shader_0 and shader_1 to shader_program, and then link 
-	// shader_program.
+	cache.keys[slot] = key;
 
-	glAttachShader(shader_program, shader_0);
-	glAttachShader(shader_program, shader_1);
+	cache.values[slot] = i;
 
-	glLinkProgram(shader_program);
+	return i;
+}
 
-	// Check if shader_program failed linkage. If so, print out the error 
-	// message provied by OpenGL.
+/*
 
-	GLint success_program = 0;
+Return the position of a vertex in the middle of pt_1 and pt_2, projected
+onto the unit sphere.
 
-	glGetProgramiv(shader_program, GL_LINK_STATUS, &success_program);
+*/
 
-	if (!success_program)
-	{
-		std::cout << "Could not link shader program loaded from \"" << shader_path_0 << "\" and \"" << shader_path_1 << "\"." << std::endl;
+glm::vec3 get_middle_position(glm::vec3 pt_1, glm::vec3 pt_2)
+{
+	glm::vec3 pt_middle = (pt_1 + pt_2) / 2.0f;
 
-		GLchar crash_information_program[16 * 1024];
+	return pt_middle / glm::length(pt_middle);
+}
 
-		glGetProgramInfoLog(shader_program, 16 * 1024, NULL, crash_information_program);
+/*
+
+Add the 12 vertices of an icosahedron to a std::vector<glm::vec3>.
+
+*/
+
+void add_icosahedron_vertices(std::vector<glm::vec3>& vector)
+{
+	float t = (1.0f + sqrt(5.0f)) / 2.0f;
+
+	add_vertex(vector, glm::vec3(-1.0f,  t, 0.0f));
+	add_vertex(vector, glm::vec3( 1.0f,  t, 0.0f));
+	add_vertex(vector, glm::vec3(-1.0f, -t, 0.0f));
+	add_vertex(vector, glm::vec3( 1.0f, -t, 0.0f));
+
+	add_vertex(vector, glm::vec3(0.0f, -1.0f,  t));
+	add_vertex(vector, glm::vec3(0.0f,  1.0f,  t));
+	add_vertex(vector, glm::vec3(0.0f, -1.0f, -t));
+	add_vertex(vector, glm::vec3(0.0f,  1.0f, -t));
+
+	add_vertex(vector, glm::vec3( t, 0.0f, -1.0f));
+	add_vertex(vector, glm::vec3( t, 0.0f,  1.0f));
+	add_vertex(vector, glm::vec3(-t, 0.0f, -1.0f));
+	add_vertex(vector, glm::vec3(-t, 0.0f,  1.0f));
+}
+
+/*
+
+The 20 faces of an icosahedron, as indices into the vertices added by
+add_icosahedron_vertices.
+
+*/
+
+const int icosahedron_faces[20][3] =
+{
+	{0x0, 0xB, 0x5},
+	{0x0, 0x5, 0x1},
+	{0x0, 0x1, 0x7},
+	{0x0, 0x7, 0xA},
+	{0x0, 0xA, 0xB},
+
+	{0x1, 0x5, 0x9},
+	{0x5, 0xB, 0x4},
+	{0xB, 0xA, 0x2},
+	{0xA, 0x7, 0x6},
+	{0x7, 0x1, 0x8},
+
+	{0x3, 0x9, 0x4},
+	{0x3, 0x4, 0x2},
+	{0x3, 0x2, 0x6},
+	{0x3, 0x6, 0x8},
+	{0x3, 0x8, 0x9},
+
+	{0x4, 0x9, 0x5},
+	{0x2, 0x4, 0xB},
+	{0x6, 0x2, 0xA},
+	{0x8, 0x6, 0x7},
+	{0x9, 0x8, 0x1}
+};
+
+/*
+
+Subdivide a triangle mesh the given amount of times. Each triangle is replaced
+by 4 triangles that are stored contiguously, so all of the triangles that come
+from one input triangle end up next to each other. New vertices are created by
+calling create_midpoint(p_1, p_2), which must return the new vertex's index.
+
+*/
+
+template <typename midpoint_function>
+void subdivide_icosphere(std::vector<triangle_indices>& icosphere_indices, int subdivisions, midpoint_function create_midpoint)
+{
+	if (subdivisions <= 0)
+	{
+		return;
+	}
+
+	// Count the edges on the boundary of the mesh, which are only used by one
+	// triangle. A closed mesh such as the icosahedron has none, while a single
+	// triangle has three.
+
+	std::vector<uint64_t> edge_keys;
+
+	for (int i = 0; i < icosphere_indices.size(); i++)
+	{
+		edge_keys.push_back(get_edge_key(std::get<0>(icosphere_indices[i]), std::get<1>(icosphere_indices[i])));
+		edge_keys.push_back(get_edge_key(std::get<1>(icosphere_indices[i]), std::get<2>(icosphere_indices[i])));
+		edge_keys.push_back(get_edge_key(std::get<2>(icosphere_indices[i]), std::get<0>(icosphere_indices[i])));
+	}
+
+	std::sort(edge_keys.begin(), edge_keys.end());
+
+	size_t boundary_edges = 0;
+
+	for (int i = 0; i < edge_keys.size(); i++)
+	{
+		if ((i == 0 || edge_keys[i - 1] != edge_keys[i]) && (i + 1 == edge_keys.size() || edge_keys[i + 1] != edge_keys[i]))
+		{
+			boundary_edges++;
+		}
+	}
+
+	// Create a midpoint_cache that is large enough to hold every edge of the
+	// last subdivision. A mesh of t triangles with b boundary edges has 
+	// (3 * t + b) / 2 edges, and the last subdivision splits the edges of the
+	// previous level.
+
+	size_t last_triangles = icosphere_indices.size() << (2 * (subdivisions - 1));
+
+	size_t last_boundary_edges = boundary_edges << (subdivisions - 1);
+
+	midpoint_cache cache = create_midpoint_cache((3 * last_triangles + last_boundary_edges) / 2);
+
+	// Allocate two arena buffers with room for every triangle of the last 
+	// subdivision. Each subdivision reads the current mesh from one buffer 
+	// and writes the next mesh to the other, then the two buffers swap roles,
+	// so nothing is allocated or copied while subdividing.
+
+	size_t triangle_count = icosphere_indices.size();
+
+	size_t final_triangle_count = triangle_count << (2 * subdivisions);
+
+	icosphere_indices.resize(final_triangle_count);
+
+	std::vector<triangle_indices> new_icosphere_indices(final_triangle_count);
+
+	// Subdivide the mesh.
+
+	for (int i = 0; i < subdivisions; i++)
+	{
+		// The midpoints of the previous level are never looked up again,
+		// because every edge of the current level is new.
+
+		clear_midpoint_cache(cache);
+
+		// Subdivide each triangle in the current mesh.
+
+		for (size_t j = 0; j < triangle_count; j++)
+		{
+			triangle_indices tri = icosphere_indices[j];
+
+			int a = get_middle_point(cache, std::get<0>(tri), std::get<1>(tri), create_midpoint);
+			int b = get_middle_point(cache, std::get<1>(tri), std::get<2>(tri), create_midpoint);
+			int c = get_middle_point(cache, std::get<2>(tri), std::get<0>(tri), create_midpoint);
+
+			// Write the 4 new triangles to the other buffer.
+
+			new_icosphere_indices[j * 4 + 0] = triangle_indices(std::get<0>(tri), a, c);
+			new_icosphere_indices[j * 4 + 1] = triangle_indices(std::get<1>(tri), b, a);
+			new_icosphere_indices[j * 4 + 2] = triangle_indices(std::get<2>(tri), c, b);
+
+			new_icosphere_indices[j * 4 + 3] = triangle_indices(a, b, c);
+		}
+
+		// Swap the roles of the two buffers.
+
+		icosphere_indices.swap(new_icosphere_indices);
+
+		triangle_count *= 4;
+	}
+}
+
+/*
+
+An indexed_mesh holds a list of unique vertices and a list of indices into
+that list. Every three consecutive indices define a triangle.
+
+*/
+
+struct indexed_mesh
+{
+	std::vector<glm::vec3> vertices;
+
+	std::vector<unsigned int> indices;
+};
+
+/*
+
+The 30 edges of an icosahedron. Each face refers to its edges in the order
+(corner 0, corner 1), (corner 1, corner 2) and (corner 2, corner 0).
+
+*/
+
+struct icosahedron_edges
+{
+	// The vertices at both ends of each edge, lowest index first.
+
+	int vertices[30][2];
+
+	// The two faces on either side of each edge, in the order that they
+	// appear in icosahedron_faces.
+
+	int faces[30][2];
+
+	// The edges of each face.
+
+	int face_edges[20][3];
+};
+
+/*
+
+Find the edges of an icosahedron. Edges are numbered in the order that they
+are first seen while walking the faces in icosahedron_faces.
+
+*/
+
+icosahedron_edges create_icosahedron_edges()
+{
+	icosahedron_edges edges;
+
+	int edge_count = 0;
+
+	for (int i = 0; i < 20; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			int p_1 = std::min(icosahedron_faces[i][j], icosahedron_faces[i][(j + 1) % 3]);
+			int p_2 = std::max(icosahedron_faces[i][j], icosahedron_faces[i][(j + 1) % 3]);
+
+			// Look for the edge among the edges that have been seen already.
+
+			int edge = 0;
+
+			while (edge < edge_count && (edges.vertices[edge][0] != p_1 || edges.vertices[edge][1] != p_2))
+			{
+				edge++;
+			}
+
+			if (edge == edge_count)
+			{
+				edges.vertices[edge][0] = p_1;
+				edges.vertices[edge][1] = p_2;
+
+				edges.faces[edge][0] = i;
+
+				edge_count++;
+			}
+			else
+			{
+				edges.faces[edge][1] = i;
+			}
+
+			edges.face_edges[i][j] = edge;
+		}
+	}
+
+	return edges;
+}
+
+/*
+
+Return the index of the vertex at (i, j) on the triangular lattice of a face
+of an icosphere with n segments per edge. The corners of the face are at 
+(0, 0), (n, 0) and (0, n).
+
+Vertices are numbered independently of how the icosphere was generated. The 12
+corners of the icosahedron come first, then the n - 1 vertices inside each of
+the 30 edges (ordered away from the edge's lowest corner), then the 
+(n - 1) * (n - 2) / 2 vertices inside each of the 20 faces (ordered row by 
+row). A vertex shared by several faces gets the same index from all of them.
+
+*/
+
+unsigned int get_lattice_vertex(const icosahedron_edges& edges, int n, int face, int i, int j)
+{
+	const int* corners = icosahedron_faces[face];
+
+	// Check if the vertex is a corner of the face.
+
+	if (i == 0 && j == 0)
+	{
+		return corners[0];
+	}
+	else if (i == n && j == 0)
+	{
+		return corners[1];
+	}
+	else if (i == 0 && j == n)
+	{
+		return corners[2];
+	}
+
+	// Check if the vertex lies on an edge of the face, and find its distance
+	// from the edge's first corner.
+
+	int edge = -1;
+
+	int k = 0;
+
+	if (j == 0)
+	{
+		edge = 0;
+
+		k = i;
+	}
+	else if (i + j == n)
+	{
+		edge = 1;
+
+		k = j;
+	}
+	else if (i == 0)
+	{
+		edge = 2;
+
+		k = n - j;
+	}
+
+	if (edge >= 0)
+	{
+		// Measure the distance from the edge's lowest corner instead, so that
+		// both faces that share the edge agree.
+
+		if (corners[edge] > corners[(edge + 1) % 3])
+		{
+			k = n - k;
+		}
+
+		return 12 + edges.face_edges[face][edge] * (n - 1) + (k - 1);
+	}
+
+	// The vertex lies inside the face. Row j holds n - 1 - j vertices.
+
+	unsigned int face_offset = 12 + 30 * (n - 1) + face * ((n - 1) * (n - 2) / 2);
+
+	unsigned int row_offset = (j - 1) * (n - 1) - (j - 1) * j / 2;
+
+	return face_offset + row_offset + (i - 1);
+}
+
+/*
+
+A lattice_vertex is a vertex of a patch of an icosahedron face, together with
+its (i, j) coordinates on the face's triangular lattice.
+
+*/
+
+struct lattice_vertex
+{
+	glm::vec3 position;
+
+	int i;
+	int j;
+
+	// A bit mask of the edges of the patch that the vertex lies on, in the 
+	// same order as the edges of a face in icosahedron_edges.
+
+	int patch_edges;
+};
+
+/*
+
+Return a lattice_vertex in the middle of two lattice_vertex objects.
+
+*/
+
+lattice_vertex get_middle_lattice_vertex(const lattice_vertex& p_1, const lattice_vertex& p_2)
+{
+	lattice_vertex middle;
+
+	middle.position = get_middle_position(p_1.position, p_2.position);
+
+	middle.i = (p_1.i + p_2.i) / 2;
+	middle.j = (p_1.j + p_2.j) / 2;
+
+	middle.patch_edges = p_1.patch_edges & p_2.patch_edges;
+
+	return middle;
+}
+
+/*
+
+Create an icosphere with the given amount of subdivisions, as an indexed mesh,
+using every thread of the thread_pool. Each face of the icosahedron is split
+into 4 ^ patch_subdivisions patches that are subdivided independently. The 
+vertices on the borders of the patches are stitched together afterwards by 
+giving them their lattice index (see get_lattice_vertex), so the result does
+not depend on the amount of threads.
+
+The triangles are ordered so that the 4 ^ subdivisions triangles that come 
+from each of the 20 faces of the icosahedron are stored contiguously, in the
+same order as subdivide_icosphere makes them.
+
+*/
+
+indexed_mesh create_icosphere_parallel(int subdivisions = 8, int patch_subdivisions = 2)
+{
+	patch_subdivisions = std::max(std::min(patch_subdivisions, subdivisions), 0);
+
+	int n = 1 << subdivisions;
+
+	int patch_count = 20 << (2 * patch_subdivisions);
+
+	size_t patch_triangle_count = size_t(1) << (2 * (subdivisions - patch_subdivisions));
+
+	icosahedron_edges edges = create_icosahedron_edges();
+
+	std::vector<glm::vec3> icosahedron_vertices;
+
+	add_icosahedron_vertices(icosahedron_vertices);
+
+	// Allocate the icosphere's mesh.
+
+	indexed_mesh icosphere_mesh;
+
+	icosphere_mesh.vertices.resize(10 * size_t(n) * size_t(n) + 2);
+
+	icosphere_mesh.indices.resize(patch_count * patch_triangle_count * 3);
+
+	// The vertices on the borders of each patch. They are written after all
+	// of the patches are done, so that no two threads ever write to the same
+	// vertex.
+
+	std::vector<std::vector<std::pair<unsigned int, glm::vec3>>> patch_borders(patch_count);
+
+	get_thread_pool().parallel_for(patch_count, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t patch = begin; patch < end; patch++)
+		{
+			int face = patch >> (2 * patch_subdivisions);
+
+			// Start with the face's corners.
+
+			lattice_vertex corners[3];
+
+			for (int i = 0; i < 3; i++)
+			{
+				corners[i].position = icosahedron_vertices[icosahedron_faces[face][i]];
+
+				corners[i].i = i == 1 ? n : 0;
+				corners[i].j = i == 2 ? n : 0;
+			}
+
+			// Walk down to the patch. Each base 4 digit of the patch's number
+			// picks one of the 4 triangles made by a subdivision, in the same
+			// order as subdivide_icosphere.
+
+			for (int level = patch_subdivisions - 1; level >= 0; level--)
+			{
+				int child = (patch >> (2 * level)) & 3;
+
+				lattice_vertex a = get_middle_lattice_vertex(corners[0], corners[1]);
+				lattice_vertex b = get_middle_lattice_vertex(corners[1], corners[2]);
+				lattice_vertex c = get_middle_lattice_vertex(corners[2], corners[0]);
+
+				if (child == 0)
+				{
+					corners[1] = a;
+					corners[2] = c;
+				}
+				else if (child == 1)
+				{
+					corners[0] = corners[1];
+					corners[1] = b;
+					corners[2] = a;
+				}
+				else if (child == 2)
+				{
+					corners[0] = corners[2];
+					corners[1] = c;
+					corners[2] = b;
+				}
+				else
+				{
+					corners[0] = a;
+					corners[1] = b;
+					corners[2] = c;
+				}
+			}
+
+			// Mark the corners as lying on the edges of the patch.
+
+			corners[0].patch_edges = 1 | 4;
+			corners[1].patch_edges = 1 | 2;
+			corners[2].patch_edges = 2 | 4;
+
+			// Subdivide the patch.
+
+			std::vector<lattice_vertex> patch_vertices(corners, corners + 3);
+
+			// A triangle split into m segments per edge has 
+			// (m + 1) * (m + 2) / 2 vertices.
+
+			size_t patch_segments = size_t(1) << (subdivisions - patch_subdivisions);
+
+			patch_vertices.reserve((patch_segments + 1) * (patch_segments + 2) / 2);
+
+			std::vector<triangle_indices> patch_indices(1, triangle_indices(0, 1, 2));
+
+			subdivide_icosphere(patch_indices, subdivisions - patch_subdivisions, [&](int p_1, int p_2)
+			{
+				patch_vertices.push_back(get_middle_lattice_vertex(patch_vertices[p_1], patch_vertices[p_2]));
+
+				return int(patch_vertices.size() - 1);
+			});
+
+			// Number the patch's vertices with their lattice indices, and
+			// write the vertices inside the patch.
+
+			std::vector<unsigned int> patch_lattice_vertices(patch_vertices.size());
+
+			for (int i = 0; i < patch_vertices.size(); i++)
+			{
+				lattice_vertex& vertex = patch_vertices[i];
+
+				patch_lattice_vertices[i] = get_lattice_vertex(edges, n, face, vertex.i, vertex.j);
+
+				if (vertex.patch_edges == 0)
+				{
+					icosphere_mesh.vertices[patch_lattice_vertices[i]] = vertex.position;
+				}
+				else
+				{
+					patch_borders[patch].push_back(std::make_pair(patch_lattice_vertices[i], vertex.position));
+				}
+			}
+
+			// Write the patch's triangles.
+
+			unsigned int* indices = &icosphere_mesh.indices[patch * patch_triangle_count * 3];
+
+			for (int i = 0; i < patch_indices.size(); i++)
+			{
+				indices[i * 3 + 0] = patch_lattice_vertices[std::get<0>(patch_indices[i])];
+				indices[i * 3 + 1] = patch_lattice_vertices[std::get<1>(patch_indices[i])];
+				indices[i * 3 + 2] = patch_lattice_vertices[std::get<2>(patch_indices[i])];
+			}
+		}
+	});
+
+	// Stitch the patches together by writing the vertices on their borders.
+	// Neighbouring patches compute bit for bit identical positions for the
+	// vertices that they share.
+
+	for (int i = 0; i < patch_count; i++)
+	{
+		for (int j = 0; j < patch_borders[i].size(); j++)
+		{
+			icosphere_mesh.vertices[patch_borders[i][j].first] = patch_borders[i][j].second;
+		}
+	}
+
+	return icosphere_mesh;
+}
+
+/*
+
+Return the position of the point at (i, j) on the triangular lattice of a 
+triangle with n segments per edge and the corners c_0, c_1 and c_2, projected
+onto the unit sphere.
+
+*/
+
+glm::vec3 get_barycentric_position(glm::vec3 c_0, glm::vec3 c_1, glm::vec3 c_2, int n, int i, int j)
+{
+	glm::vec3 position = c_0 * float(n - i - j) + c_1 * float(i) + c_2 * float(j);
+
+	return position / glm::length(position);
+}
+
+/*
+
+Write the vertices on the corners and edges of an icosahedron whose edges are 
+split into n segments, numbered as described by get_lattice_vertex. Each edge
+is interpolated from its lowest corner, so that the result does not depend on
+which face it is seen from.
+
+*/
+
+void write_barycentric_edges(indexed_mesh& icosphere_mesh, const icosahedron_edges& edges, const glm::vec3* icosahedron_vertices, int n)
+{
+	for (int i = 0; i < 12; i++)
+	{
+		icosphere_mesh.vertices[i] = icosahedron_vertices[i];
+	}
+
+	for (int i = 0; i < 30; i++)
+	{
+		glm::vec3 c_0 = icosahedron_vertices[edges.vertices[i][0]];
+		glm::vec3 c_1 = icosahedron_vertices[edges.vertices[i][1]];
+
+		for (int k = 1; k < n; k++)
+		{
+			icosphere_mesh.vertices[12 + i * (n - 1) + (k - 1)] = get_barycentric_position(c_0, c_1, c_1, n, k, 0);
+		}
+	}
+}
+
+/*
+
+Write row j of the lattice of a face of an icosahedron whose edges are split 
+into n segments. This writes the vertices inside the face on row j, and the 
+2 * (n - j) - 1 triangles between rows j and j + 1. row_0 and row_1 are 
+scratch space for n + 1 indices each.
+
+The amount of segments is a template parameter so that callers that know it at
+compile time can pass a std::integral_constant, which turns every loop bound 
+into a constant.
+
+*/
+
+template <typename segment_count>
+void write_barycentric_row
+(
+	indexed_mesh& icosphere_mesh,
+
+	const icosahedron_edges& edges,
+
+	const glm::vec3* icosahedron_vertices,
+
+	segment_count n,
+
+	int face,
+	int j,
+
+	unsigned int* row_0,
+	unsigned int* row_1
+)
+{
+	glm::vec3 c_0 = icosahedron_vertices[icosahedron_faces[face][0]];
+	glm::vec3 c_1 = icosahedron_vertices[icosahedron_faces[face][1]];
+	glm::vec3 c_2 = icosahedron_vertices[icosahedron_faces[face][2]];
+
+	// Find the indices of the vertices on rows j and j + 1, and write the 
+	// vertices inside the face on row j.
+
+	for (int i = 0; i <= n - j; i++)
+	{
+		row_0[i] = get_lattice_vertex(edges, n, face, i, j);
+
+		if (j > 0 && i > 0 && i < n - j)
+		{
+			icosphere_mesh.vertices[row_0[i]] = get_barycentric_position(c_0, c_1, c_2, n, i, j);
+		}
+	}
+
+	for (int i = 0; i < n - j; i++)
+	{
+		row_1[i] = get_lattice_vertex(edges, n, face, i, j + 1);
+	}
+
+	// Write the triangles. The rows before row j hold 2 * n * j - j * j
+	// triangles.
+
+	size_t face_triangle_count = size_t(n) * size_t(n);
+
+	unsigned int* indices = &icosphere_mesh.indices[(face * face_triangle_count + 2 * size_t(n) * j - size_t(j) * j) * 3];
+
+	for (int i = 0; i < n - j; i++)
+	{
+		*indices++ = row_0[i + 0];
+		*indices++ = row_0[i + 1];
+		*indices++ = row_1[i + 0];
+
+		// Every triangle except the last one of the row is followed by an
+		// upside down triangle.
+
+		if (i + 1 < n - j)
+		{
+			*indices++ = row_0[i + 1];
+			*indices++ = row_1[i + 1];
+			*indices++ = row_1[i + 0];
+		}
+	}
+}
+
+/*
+
+The 12 vertices of an icosahedron, already projected onto the unit sphere. 
+These are the same values that add_icosahedron_vertices computes at run time.
+
+*/
+
+constexpr float icosahedron_a = 0.525731112119133606f;
+constexpr float icosahedron_b = 0.850650808352039932f;
+
+constexpr float icosahedron_unit_vertices[12][3] =
+{
+	{-icosahedron_a,  icosahedron_b, 0.0f},
+	{ icosahedron_a,  icosahedron_b, 0.0f},
+	{-icosahedron_a, -icosahedron_b, 0.0f},
+	{ icosahedron_a, -icosahedron_b, 0.0f},
+
+	{0.0f, -icosahedron_a,  icosahedron_b},
+	{0.0f,  icosahedron_a,  icosahedron_b},
+	{0.0f, -icosahedron_a, -icosahedron_b},
+	{0.0f,  icosahedron_a, -icosahedron_b},
+
+	{ icosahedron_b, 0.0f, -icosahedron_a},
+	{ icosahedron_b, 0.0f,  icosahedron_a},
+	{-icosahedron_b, 0.0f, -icosahedron_a},
+	{-icosahedron_b, 0.0f,  icosahedron_a}
+};
+
+/*
+
+The sizes of an icosphere with a fixed amount of subdivisions, known at 
+compile time. Levels above 14 are rejected because their vertices can not be
+numbered with 32-bit indices.
+
+*/
+
+template <int Level>
+struct icosphere_level
+{
+	static_assert(Level >= 0 && Level <= 14, "icosphere_level supports 0 to 14 subdivisions.");
+
+	// The amount of segments along each edge of the icosahedron.
+
+	static constexpr int segments = 1 << Level;
+
+	// The amount of vertices, triangles and indices of the icosphere.
+
+	static constexpr size_t vertex_count = 10 * size_t(segments) * size_t(segments) + 2;
+
+	static constexpr size_t triangle_count = 20 * size_t(segments) * size_t(segments);
+
+	static constexpr size_t index_count = triangle_count * 3;
+};
+
+template <int Level> constexpr int icosphere_level<Level>::segments;
+
+template <int Level> constexpr size_t icosphere_level<Level>::vertex_count;
+template <int Level> constexpr size_t icosphere_level<Level>::triangle_count;
+template <int Level> constexpr size_t icosphere_level<Level>::index_count;
+
+/*
+
+Create an icosphere with a fixed amount of subdivisions, as an indexed mesh. 
+The final grid of each face is generated directly from the (i, j) coordinates
+of its triangular lattice, so no intermediate levels are ever stored. The 
+buffers are allocated once with their exact sizes and the amount of segments 
+is a constant in every loop. The work is spread over every thread of the 
+thread_pool.
+
+Vertices are numbered as described by get_lattice_vertex. The triangles of 
+each face are stored contiguously, row by row. The result has the same 
+topology as create_icosphere_parallel(Level), but the positions differ 
+slightly, because each vertex is projected onto the sphere once instead of 
+once per subdivision.
+
+*/
+
+template <int Level>
+indexed_mesh create_icosphere_fixed()
+{
+	typedef icosphere_level<Level> level;
+
+	typedef std::integral_constant<int, level::segments> segment_count;
+
+	icosahedron_edges edges = create_icosahedron_edges();
+
+	glm::vec3 icosahedron_vertices[12];
+
+	for (int i = 0; i < 12; i++)
+	{
+		icosahedron_vertices[i] = glm::vec3(icosahedron_unit_vertices[i][0], icosahedron_unit_vertices[i][1], icosahedron_unit_vertices[i][2]);
+	}
+
+	// Allocate the icosphere's mesh.
+
+	indexed_mesh icosphere_mesh;
+
+	icosphere_mesh.vertices.resize(level::vertex_count);
+
+	icosphere_mesh.indices.resize(level::index_count);
+
+	// Write the vertices on the corners and edges of the icosahedron, then
+	// the rows of each face.
+
+	write_barycentric_edges(icosphere_mesh, edges, icosahedron_vertices, level::segments);
+
+	get_thread_pool().parallel_for(20 * level::segments, 16, [&](size_t begin, size_t end)
+	{
+		std::array<unsigned int, level::segments + 1> row_0;
+		std::array<unsigned int, level::segments + 1> row_1;
+
+		for (size_t row = begin; row < end; row++)
+		{
+			write_barycentric_row(icosphere_mesh, edges, icosahedron_vertices, segment_count(), row / level::segments, row % level::segments, row_0.data(), row_1.data());
+		}
+	});
+
+	return icosphere_mesh;
+}
+
+/*
+
+A geodesic_address identifies a vertex of an icosphere by the face of the
+icosahedron that it lies on, and its (i, j) coordinates on the triangular 
+lattice of that face. Vertices on the edges of the icosahedron can be 
+addressed from every face that they lie on.
+
+*/
+
+struct geodesic_address
+{
+	int face;
+
+	int i;
+	int j;
+};
+
+/*
+
+A geodesic_grid describes the vertices of an icosphere with 2 ^ level
+segments per icosahedron edge, as made by create_icosphere_fixed<level>. It 
+converts between vertex indices, geodesic_address objects and positions, and 
+finds the neighbours, parents and children of vertices, all in constant time 
+and without building any adjacency tables.
+
+*/
+
+class geodesic_grid
+{
+public:
+
+	geodesic_grid(int level)
+	{
+		this->level = level;
+
+		n = 1 << level;
+
+		edges = create_icosahedron_edges();
+
+		add_icosahedron_vertices(icosahedron_vertices);
+	}
+
+	// Return the amount of subdivisions, and the amount of segments along 
+	// each edge of the icosahedron.
+
+	int get_level() const
+	{
+		return level;
+	}
+
+	int get_segments() const
+	{
+		return n;
+	}
+
+	// Return the amount of vertices in the grid.
+
+	unsigned int get_vertex_count() const
+	{
+		return 10 * n * n + 2;
+	}
+
+	// Return the index of the vertex at an address.
+
+	unsigned int get_index(const geodesic_address& address) const
+	{
+		return get_lattice_vertex(edges, n, address.face, address.i, address.j);
+	}
+
+	// Return the address of a vertex. Vertices on the edges of the 
+	// icosahedron are addressed from the first face that they lie on.
+
+	geodesic_address get_address(unsigned int index) const
+	{
+		geodesic_address address;
+
+		unsigned int edge_vertex_count = n - 1;
+
+		unsigned int face_vertex_count = (n - 1) * (n - 2) / 2;
+
+		if (index < 12)
+		{
+			// The vertex is a corner of the icosahedron.
+
+			address.face = 0;
+
+			while (get_corner(address.face, index) < 0)
+			{
+				address.face++;
+			}
+
+			int corner = get_corner(address.face, index);
+
+			address.i = corner == 1 ? n : 0;
+			address.j = corner == 2 ? n : 0;
+		}
+		else if (index < 12 + 30 * edge_vertex_count)
+		{
+			// The vertex lies inside an edge of the icosahedron, at distance
+			// k from the edge's lowest corner.
+
+			int edge = (index - 12) / edge_vertex_count;
+
+			int k = (index - 12) % edge_vertex_count + 1;
+
+			address.face = edges.faces[edge][0];
+
+			int slot = 0;
+
+			while (edges.face_edges[address.face][slot] != edge)
+			{
+				slot++;
+			}
+
+			// Measure k from the slot's first corner instead.
+
+			if (icosahedron_faces[address.face][slot] > icosahedron_faces[address.face][(slot + 1) % 3])
+			{
+				k = n - k;
+			}
+
+			address.i = slot == 0 ? k : slot == 1 ? n - k : 0;
+			address.j = slot == 0 ? 0 : slot == 1 ? k : n - k;
+		}
+		else
+		{
+			// The vertex lies inside a face. Row t (counting from j = 1) 
+			// starts after t * (n - 2) - t * (t - 1) / 2 vertices, so the row
+			// is found by solving a quadratic and then correcting for 
+			// rounding.
+
+			unsigned int r = index - 12 - 30 * edge_vertex_count;
+
+			address.face = r / face_vertex_count;
+
+			r %= face_vertex_count;
+
+			double b = 2.0 * n - 3.0;
+
+			int t = int((b - std::sqrt(std::max(b * b - 8.0 * r, 0.0))) / 2.0);
+
+			t = std::max(std::min(t, n - 3), 0);
+
+			while (t > 0 && get_row_offset(t) > r)
+			{
+				t--;
+			}
+
+			while (t < n - 3 && get_row_offset(t + 1) <= r)
+			{
+				t++;
+			}
+
+			address.i = r - get_row_offset(t) + 1;
+			address.j = t + 1;
+		}
+
+		return address;
+	}
+
+	// Return the position of a vertex on the unit sphere.
+
+	glm::vec3 get_position(unsigned int index) const
+	{
+		geodesic_address address = get_address(index);
+
+		if (index < 12)
+		{
+			return icosahedron_vertices[index];
+		}
+		else if (index < 12 + 30 * (unsigned int)(n - 1))
+		{
+			// Interpolate from the edge's lowest corner, the same way as 
+			// write_barycentric_edges.
+
+			int edge = (index - 12) / (n - 1);
+
+			int k = (index - 12) % (n - 1) + 1;
+
+			glm::vec3 c_0 = icosahedron_vertices[edges.vertices[edge][0]];
+			glm::vec3 c_1 = icosahedron_vertices[edges.vertices[edge][1]];
+
+			return get_barycentric_position(c_0, c_1, c_1, n, k, 0);
+		}
+
+		glm::vec3 c_0 = icosahedron_vertices[icosahedron_faces[address.face][0]];
+		glm::vec3 c_1 = icosahedron_vertices[icosahedron_faces[address.face][1]];
+		glm::vec3 c_2 = icosahedron_vertices[icosahedron_faces[address.face][2]];
+
+		return get_barycentric_position(c_0, c_1, c_2, n, address.i, address.j);
+	}
+
+	// Write the indices of the neighbours of a vertex to neighbours, and 
+	// return how many there are. The 12 corners of the icosahedron have 5 
+	// neighbours, every other vertex has 6, listed counter-clockwise.
+
+	int get_neighbours(unsigned int index, unsigned int neighbours[6]) const
+	{
+		return get_neighbours(n, get_address(index), neighbours);
+	}
+
+	// Write the indices of the vertices on the grid with one level less that
+	// a vertex comes from to parents, and return how many there are. A vertex
+	// that already exists on the coarser grid has 1 parent, a vertex that 
+	// splits an edge of the coarser grid has the edge's 2 corners as parents.
+	// Vertices on a grid with no subdivisions have no parents.
+
+	int get_parents(unsigned int index, unsigned int parents[2]) const
+	{
+		if (level == 0)
+		{
+			return 0;
+		}
+
+		geodesic_address address = get_address(index);
+
+		int i = address.i;
+		int j = address.j;
+
+		if (i % 2 == 0 && j % 2 == 0)
+		{
+			parents[0] = get_lattice_vertex(edges, n / 2, address.face, i / 2, j / 2);
+
+			return 1;
+		}
+
+		// Find the edge of the coarser grid that the vertex splits. The 
+		// coarse lattice has edges along (1, 0), (0, 1) and (1, -1).
+
+		int di = 1;
+		int dj = 0;
+
+		if (i % 2 == 0)
+		{
+			di = 0;
+			dj = 1;
+		}
+		else if (j % 2 == 1)
+		{
+			dj = -1;
+		}
+
+		parents[0] = get_lattice_vertex(edges, n / 2, address.face, (i - di) / 2, (j - dj) / 2);
+		parents[1] = get_lattice_vertex(edges, n / 2, address.face, (i + di) / 2, (j + dj) / 2);
+
+		return 2;
+	}
+
+	// Write the indices of the children of a vertex on the grid with one 
+	// level more to children, and return how many there are. The first child
+	// is the vertex itself, the others split the edges around it.
+
+	int get_children(unsigned int index, unsigned int children[7]) const
+	{
+		geodesic_address address = get_address(index);
+
+		address.i *= 2;
+		address.j *= 2;
+
+		children[0] = get_lattice_vertex(edges, n * 2, address.face, address.i, address.j);
+
+		return 1 + get_neighbours(n * 2, address, children + 1);
+	}
+
+private:
+
+	// Return which corner of a face a vertex of the icosahedron is, or -1 if
+	// the face does not touch it.
+
+	int get_corner(int face, int vertex) const
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (icosahedron_faces[face][i] == vertex)
+			{
+				return i;
+			}
+		}
+
+		return -1;
+	}
+
+	// Return the amount of vertices inside a face before row t (counting 
+	// from j = 1).
+
+	unsigned int get_row_offset(int t) const
+	{
+		return t * (n - 2) - t * (t - 1) / 2;
+	}
+
+	// Write the neighbours of an address on a grid with m segments per edge.
+
+	int get_neighbours(int m, const geodesic_address& address, unsigned int neighbours[6]) const
+	{
+		const int* corners = icosahedron_faces[address.face];
+
+		int slot = -1;
+
+		if (address.i == 0 && address.j == 0)
+		{
+			slot = 0;
+		}
+		else if (address.i == m && address.j == 0)
+		{
+			slot = 1;
+		}
+		else if (address.i == 0 && address.j == m)
+		{
+			slot = 2;
+		}
+
+		if (slot >= 0)
+		{
+			// The neighbours of a corner are the first vertices along the 5
+			// edges that meet at it. The faces around the corner are visited
+			// counter-clockwise: the corner that follows it in a face is the
+			// next neighbour, and the next face shares the edge to the corner
+			// that precedes it.
+
+			int corner = corners[slot];
+
+			int face = address.face;
+
+			for (int k = 0; k < 5; k++)
+			{
+				int next = icosahedron_faces[face][(slot + 1) % 3];
+
+				int edge = edges.face_edges[face][slot];
+
+				if (m == 1)
+				{
+					neighbours[k] = next;
+				}
+				else
+				{
+					neighbours[k] = 12 + edge * (m - 1) + (edges.vertices[edge][0] == corner ? 0 : m - 2);
+				}
+
+				edge = edges.face_edges[face][(slot + 2) % 3];
+
+				face = edges.faces[edge][0] == face ? edges.faces[edge][1] : edges.faces[edge][0];
+
+				slot = get_corner(face, corner);
+			}
+
+			return 5;
+		}
+
+		// Step to each of the 6 lattice neighbours. A step that leaves the 
+		// face crosses exactly one of its edges, because only corners touch 
+		// two edges.
+
+		const int steps[6][2] = {{1, 0}, {0, 1}, {-1, 1}, {-1, 0}, {0, -1}, {1, -1}};
+
+		for (int k = 0; k < 6; k++)
+		{
+			int i = address.i + steps[k][0];
+			int j = address.j + steps[k][1];
+
+			// Find the barycentric weights of the step on the face's corners,
+			// and the edge that it crosses.
+
+			int weights[3] = {m - i - j, i, j};
+
+			int slot = weights[2] < 0 ? 0 : weights[0] < 0 ? 1 : weights[1] < 0 ? 2 : -1;
+
+			if (slot < 0)
+			{
+				neighbours[k] = get_lattice_vertex(edges, m, address.face, i, j);
+
+				continue;
+			}
+
+			// Unfold the face that shares the edge into the plane of the 
+			// current face. The corner opposite to the edge is then the sum of
+			// the edge's corners minus the other face's far corner, which 
+			// moves its (negative) weight onto the edge's corners and the far
+			// corner.
+
+			int c_0 = corners[slot];
+			int c_1 = corners[(slot + 1) % 3];
+
+			int w_0 = weights[slot] + weights[(slot + 2) % 3];
+			int w_1 = weights[(slot + 1) % 3] + weights[(slot + 2) % 3];
+			int w_2 = -weights[(slot + 2) % 3];
+
+			int edge = edges.face_edges[address.face][slot];
+
+			int face = edges.faces[edge][0] == address.face ? edges.faces[edge][1] : edges.faces[edge][0];
+
+			// Read the weights of the other face's second and third corners,
+			// which are its (i, j) coordinates.
+
+			int face_weights[2];
+
+			for (int l = 0; l < 2; l++)
+			{
+				int c = icosahedron_faces[face][l + 1];
+
+				face_weights[l] = c == c_0 ? w_0 : c == c_1 ? w_1 : w_2;
+			}
+
+			neighbours[k] = get_lattice_vertex(edges, m, face, face_weights[0], face_weights[1]);
+		}
+
+		return 6;
+	}
+
+	int level;
+
+	int n;
+
+	icosahedron_edges edges;
+
+	std::vector<glm::vec3> icosahedron_vertices;
+};
+
+/*
+
+Create an icosphere with the given amount of subdivisions, as a list of
+ordered vertices where every three consecutive vertices define a triangle.
+
+*/
+
+std::vector<glm::vec3> create_icosphere(int subdivisions = 8)
+{
+	indexed_mesh icosphere_indexed_mesh = create_icosphere_parallel(subdivisions);
+
+	// Expand the indexed mesh into a list of ordered vertices.
+
+	std::vector<glm::vec3> icosphere_mesh;
+
+	icosphere_mesh.reserve(icosphere_indexed_mesh.indices.size());
+
+	for (int i = 0; i < icosphere_indexed_mesh.indices.size(); i++)
+	{
+		icosphere_mesh.push_back(icosphere_indexed_mesh.vertices[icosphere_indexed_mesh.indices[i]]);
+	}
+
+	// Return the icosphere's mesh.
+
+	return icosphere_mesh;
+}
+
+/*
+
+Weld a triangle soup (such as the one returned by create_icosphere) into an
+indexed_mesh. Vertices that are at most epsilon apart are welded together, 
+and epsilon 0 only welds vertices that are exactly equal. The result has one
+index per vertex of the soup, in the same order, so every triangle of the 
+soup is kept (even if welding makes it degenerate), and the unique vertices 
+are ordered by their first appearance in the soup.
+
+The soup is put into a spatial hash of cubic cells whose size is 2 * epsilon,
+so that the vertices within epsilon of a vertex are in at most 2 cells along
+each axis, the ones that contain its coordinates plus and minus epsilon. 
+Every vertex then finds, in parallel, the first vertex of the soup
+that is within epsilon of it, and is welded into whatever vertex that one was
+welded into. Because of this the result does not depend on the amount of 
+threads, even when a chain of vertices is closer than epsilon pair by pair.
+
+*/
+
+indexed_mesh weld_vertices(const std::vector<glm::vec3>& soup, float epsilon = 1e-6f)
+{
+	size_t vertex_count = soup.size();
+
+	// Find the cell of every vertex. With epsilon 0, the cell of a vertex is
+	// its bits, adding 0 to turn -0 into 0.
+
+	float cell_size = epsilon * 2.0f;
+
+	std::vector<std::array<int64_t, 3>> cells(vertex_count);
+
+	get_thread_pool().parallel_for(vertex_count, 4096, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				if (epsilon > 0.0f)
+				{
+					cells[i][j] = (int64_t)std::floor(soup[i][j] / cell_size);
+				}
+				else
+				{
+					float component = soup[i][j] + 0.0f;
+
+					uint32_t bits;
+
+					memcpy(&bits, &component, sizeof(float));
+
+					cells[i][j] = bits;
+				}
+			}
+		}
+	});
+
+	// Hash the cells into a power of two amount of buckets, and sort the
+	// vertices by bucket with a counting sort, so that the vertices of each
+	// bucket are contiguous and in the order of the soup.
+
+	size_t bucket_count = 1;
+
+	while (bucket_count < vertex_count)
+	{
+		bucket_count *= 2;
+	}
+
+	auto get_bucket = [bucket_count](const std::array<int64_t, 3>& cell)
+	{
+		uint64_t hash = uint64_t(cell[0]) * 73856093ULL ^ uint64_t(cell[1]) * 19349663ULL ^ uint64_t(cell[2]) * 83492791ULL;
+
+		return size_t((hash ^ (hash >> 29)) & (bucket_count - 1));
+	};
+
+	std::vector<size_t> vertex_buckets(vertex_count);
+
+	get_thread_pool().parallel_for(vertex_count, 4096, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			vertex_buckets[i] = get_bucket(cells[i]);
+		}
+	});
+
+	std::vector<unsigned int> bucket_starts(bucket_count + 1, 0);
+
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		bucket_starts[vertex_buckets[i] + 1]++;
+	}
+
+	for (size_t i = 0; i < bucket_count; i++)
+	{
+		bucket_starts[i + 1] += bucket_starts[i];
+	}
+
+	std::vector<unsigned int> bucket_vertices(vertex_count);
+
+	{
+		std::vector<unsigned int> bucket_ends(bucket_starts.begin(), bucket_starts.end() - 1);
+
+		for (size_t i = 0; i < vertex_count; i++)
+		{
+			bucket_vertices[bucket_ends[vertex_buckets[i]]++] = i;
+		}
+	}
+
+	// Find the first vertex within epsilon of every vertex, which may be the
+	// vertex itself.
+
+	std::vector<unsigned int> first_vertices(vertex_count);
+
+	get_thread_pool().parallel_for(vertex_count, 4096, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			unsigned int first = i;
+
+			// Find the range of cells to search along each axis.
+
+			std::array<int64_t, 3> low = cells[i];
+			std::array<int64_t, 3> high = cells[i];
+
+			if (epsilon > 0.0f)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					low[j] = (int64_t)std::floor((soup[i][j] - epsilon) / cell_size);
+
+					high[j] = (int64_t)std::floor((soup[i][j] + epsilon) / cell_size);
+				}
+			}
+
+			for (int64_t x = low[0]; x <= high[0]; x++)
+			{
+				for (int64_t y = low[1]; y <= high[1]; y++)
+				{
+					for (int64_t z = low[2]; z <= high[2]; z++)
+					{
+						std::array<int64_t, 3> cell = {{x, y, z}};
+
+						size_t bucket = get_bucket(cell);
+
+						// The bucket's vertices are in the order of the soup,
+						// so only the ones before the best so far are checked.
+
+						for (unsigned int k = bucket_starts[bucket]; k < bucket_starts[bucket + 1] && bucket_vertices[k] < first; k++)
+						{
+							unsigned int other = bucket_vertices[k];
+
+							bool welded = epsilon > 0.0f ? glm::length(soup[other] - soup[i]) <= epsilon : cells[other] == cells[i];
+
+							if (welded)
+							{
+								first = other;
+
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			first_vertices[i] = first;
+		}
+	});
+
+	// Give every vertex that is its own first vertex the next index of the 
+	// mesh, and every other vertex the index of its first vertex, which comes
+	// before it in the soup.
+
+	indexed_mesh mesh;
+
+	mesh.indices.resize(vertex_count);
+
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		if (first_vertices[i] == i)
+		{
+			mesh.indices[i] = mesh.vertices.size();
+
+			mesh.vertices.push_back(soup[i]);
+		}
+		else
+		{
+			mesh.indices[i] = mesh.indices[first_vertices[i]];
+		}
+	}
+
+	return mesh;
+}
+
+/*
+
+Calculate the smooth normal of each vertex of an indexed mesh by accumulating
+the normals of the triangles around it. The cross product of two edges of a 
+triangle is proportional to the triangle's area, so larger triangles 
+contribute more.
+
+The index buffer is walked once, normal_block_size triangles at a time. The 
+corners of a block are gathered into separate arrays of x, y and z 
+components, so that the cross products of the whole block are computed by one
+loop of fixed length that the compiler turns into SIMD instructions. The 
+results are then added to the block's vertices.
+
+*/
+
+const int normal_block_size = 16;
+
+std::vector<glm::vec3> get_smooth_normals(const indexed_mesh& mesh)
+{
+	std::vector<glm::vec3> normals(mesh.vertices.size(), glm::vec3(0.0f));
+
+	size_t triangle_count = mesh.indices.size() / 3;
+
+	// The components of the corners of the block's triangles, and of their 
+	// normals.
+
+	float corners[3][3][normal_block_size];
+
+	float block_normals[3][normal_block_size];
+
+	for (size_t first = 0; first < triangle_count; first += normal_block_size)
+	{
+		size_t count = std::min(triangle_count - first, size_t(normal_block_size));
+
+		// Gather the corners. The rest of the last block is filled with 
+		// zeros, which give zero normals.
+
+		for (int i = 0; i < 3; i++)
+		{
+			for (size_t j = 0; j < normal_block_size; j++)
+			{
+				glm::vec3 corner = j < count ? mesh.vertices[mesh.indices[(first + j) * 3 + i]] : glm::vec3(0.0f);
+
+				corners[i][0][j] = corner.x;
+				corners[i][1][j] = corner.y;
+				corners[i][2][j] = corner.z;
+			}
+		}
+
+		// Calculate the normals of the whole block.
+
+		for (int j = 0; j < normal_block_size; j++)
+		{
+			float edge_1_x = corners[1][0][j] - corners[0][0][j];
+			float edge_1_y = corners[1][1][j] - corners[0][1][j];
+			float edge_1_z = corners[1][2][j] - corners[0][2][j];
+
+			float edge_2_x = corners[2][0][j] - corners[0][0][j];
+			float edge_2_y = corners[2][1][j] - corners[0][1][j];
+			float edge_2_z = corners[2][2][j] - corners[0][2][j];
+
+			block_normals[0][j] = edge_1_y * edge_2_z - edge_1_z * edge_2_y;
+			block_normals[1][j] = edge_1_z * edge_2_x - edge_1_x * edge_2_z;
+			block_normals[2][j] = edge_1_x * edge_2_y - edge_1_y * edge_2_x;
+		}
+
+		// Add the normals to the vertices.
+
+		for (size_t j = 0; j < count; j++)
+		{
+			glm::vec3 normal = glm::vec3(block_normals[0][j], block_normals[1][j], block_normals[2][j]);
+
+			for (int i = 0; i < 3; i++)
+			{
+				normals[mesh.indices[(first + j) * 3 + i]] += normal;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < normals.size(); i++)
+	{
+		normals[i] = glm::normalize(normals[i]);
+	}
+
+	return normals;
+}
+
+/*
+
+Simulate a FIFO post-transform vertex cache with cache_size entries while 
+drawing a list of indexed triangles, and return the average cache miss ratio
+(ACMR), which is the amount of vertices transformed per triangle. It lies 
+between about 0.5 for a perfectly ordered regular mesh and 3 for a mesh with no
+vertex reuse at all.
+
+*/
+
+float get_acmr(const unsigned int* indices, size_t index_count, size_t vertex_count, size_t cache_size = 16)
+{
+	if (index_count < 3)
+	{
+		return 0.0f;
+	}
+
+	// A vertex is in the cache if fewer than cache_size misses happened since
+	// it was last missed. Vertices that were never missed have a timestamp 
+	// of 0 and are never in the cache, misses start at cache_size + 1.
+
+	std::vector<size_t> timestamps(vertex_count, 0);
+
+	size_t misses = cache_size + 1;
+
+	for (size_t i = 0; i < index_count; i++)
+	{
+		unsigned int vertex = indices[i];
+
+		if (misses - timestamps[vertex] > cache_size)
+		{
+			timestamps[vertex] = misses++;
+		}
+	}
+
+	return float(misses - cache_size - 1) / float(index_count / 3);
+}
+
+/*
+
+Return the score of a vertex for optimize_vertex_cache, from its position in 
+the simulated LRU cache (or -1 if it is not in the cache) and the amount of 
+triangles that still use it. The last triangle's vertices get a fixed score,
+so that the next triangle is not always chosen right next to it, and vertices
+with few remaining triangles are boosted, so that they are finished off before
+they would leave the cache.
+
+*/
+
+const int vertex_cache_size = 32;
+
+float get_vertex_cache_score(int cache_position, int remaining_triangles)
+{
+	if (remaining_triangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+
+	if (cache_position >= 0)
+	{
+		if (cache_position < 3)
+		{
+			score = 0.75f;
+		}
+		else
+		{
+			score = std::pow(1.0f - float(cache_position - 3) / float(vertex_cache_size - 3), 1.5f);
+		}
+	}
+
+	return score + 2.0f / std::sqrt(float(remaining_triangles));
+}
+
+/*
+
+Reorder a list of indexed triangles for the post-transform vertex cache, using
+Tom Forsyth's linear-speed vertex cache optimisation. Each step emits the 
+triangle with the highest score among the triangles that use a vertex in a 
+simulated LRU cache. The order of the corners of each triangle, and so its 
+winding, is kept.
+
+*/
+
+void optimize_vertex_cache(unsigned int* indices, size_t index_count, size_t vertex_count)
+{
+	size_t triangle_count = index_count / 3;
+
+	if (triangle_count == 0)
+	{
+		return;
+	}
+
+	// Build the lists of triangles that use each vertex. Emitted triangles 
+	// are removed from the lists, so the first remaining_triangles[i] entries
+	// of vertex i's list are the triangles that still use it.
+
+	std::vector<int> remaining_triangles(vertex_count, 0);
+
+	for (size_t i = 0; i < index_count; i++)
+	{
+		remaining_triangles[indices[i]]++;
+	}
+
+	std::vector<size_t> first_triangle(vertex_count + 1, 0);
+
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		first_triangle[i + 1] = first_triangle[i] + remaining_triangles[i];
+	}
+
+	std::vector<unsigned int> vertex_triangles(index_count);
+
+	std::vector<int> filled(vertex_count, 0);
+
+	for (size_t i = 0; i < index_count; i++)
+	{
+		unsigned int vertex = indices[i];
+
+		vertex_triangles[first_triangle[vertex] + filled[vertex]++] = i / 3;
+	}
+
+	// Find the initial scores of the vertices and the triangles.
+
+	std::vector<int> cache_positions(vertex_count, -1);
+
+	std::vector<float> vertex_scores(vertex_count);
+
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		vertex_scores[i] = get_vertex_cache_score(-1, remaining_triangles[i]);
+	}
+
+	std::vector<float> triangle_scores(triangle_count);
+
+	std::vector<bool> emitted(triangle_count, false);
+
+	int best_triangle = 0;
+
+	for (size_t i = 0; i < triangle_count; i++)
+	{
+		triangle_scores[i] = vertex_scores[indices[i * 3 + 0]] + vertex_scores[indices[i * 3 + 1]] + vertex_scores[indices[i * 3 + 2]];
+
+		if (triangle_scores[i] > triangle_scores[best_triangle])
+		{
+			best_triangle = i;
+		}
+	}
+
+	// Emit the triangles.
+
+	std::vector<unsigned int> output(index_count);
+
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> new_cache;
+
+	size_t next_unemitted = 0;
+
+	for (size_t i = 0; i < triangle_count; i++)
+	{
+		// When no triangle in the cache is left, continue with the next 
+		// triangle in the original order.
+
+		if (best_triangle < 0)
+		{
+			while (emitted[next_unemitted])
+			{
+				next_unemitted++;
+			}
+
+			best_triangle = next_unemitted;
+		}
+
+		const unsigned int* triangle = indices + best_triangle * 3;
+
+		output[i * 3 + 0] = triangle[0];
+		output[i * 3 + 1] = triangle[1];
+		output[i * 3 + 2] = triangle[2];
+
+		emitted[best_triangle] = true;
+
+		// Remove the triangle from its vertices' lists.
+
+		for (int j = 0; j < 3; j++)
+		{
+			unsigned int vertex = triangle[j];
+
+			unsigned int* list = &vertex_triangles[first_triangle[vertex]];
+
+			int count = remaining_triangles[vertex];
+
+			for (int k = 0; k < count; k++)
+			{
+				if (list[k] == unsigned(best_triangle))
+				{
+					std::swap(list[k], list[count - 1]);
+
+					break;
+				}
+			}
+
+			remaining_triangles[vertex]--;
+		}
+
+		// Move the triangle's vertices to the front of the cache. The cache
+		// holds up to 3 vertices too many, which are evicted below.
+
+		new_cache.assign(triangle, triangle + 3);
+
+		for (size_t j = 0; j < cache.size(); j++)
+		{
+			if (cache[j] != triangle[0] && cache[j] != triangle[1] && cache[j] != triangle[2])
+			{
+				new_cache.push_back(cache[j]);
+			}
+		}
+
+		cache.swap(new_cache);
+
+		// Update the scores of the vertices in the cache, and of the 
+		// triangles that use them, and find the best of those triangles.
+
+		best_triangle = -1;
+
+		float best_score = -1.0f;
+
+		for (size_t j = 0; j < cache.size(); j++)
+		{
+			unsigned int vertex = cache[j];
+
+			cache_positions[vertex] = j < vertex_cache_size ? j : -1;
+
+			float score = get_vertex_cache_score(cache_positions[vertex], remaining_triangles[vertex]);
+
+			float score_change = score - vertex_scores[vertex];
+
+			vertex_scores[vertex] = score;
+
+			const unsigned int* list = &vertex_triangles[first_triangle[vertex]];
+
+			for (int k = 0; k < remaining_triangles[vertex]; k++)
+			{
+				triangle_scores[list[k]] += score_change;
+			}
+		}
+
+		for (size_t j = 0; j < std::min(cache.size(), size_t(vertex_cache_size)); j++)
+		{
+			unsigned int vertex = cache[j];
+
+			const unsigned int* list = &vertex_triangles[first_triangle[vertex]];
+
+			for (int k = 0; k < remaining_triangles[vertex]; k++)
+			{
+				if (triangle_scores[list[k]] > best_score)
+				{
+					best_triangle = list[k];
+
+					best_score = triangle_scores[list[k]];
+				}
+			}
+		}
+
+		if (cache.size() > vertex_cache_size)
+		{
+			cache.resize(vertex_cache_size);
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+/*
+
+Reorder the clusters of a list of indexed triangles to reduce overdraw, 
+without undoing much of optimize_vertex_cache. This is the view-independent
+method of Sander, Nehab and Barczak. The triangles are split into clusters 
+wherever the simulated cache starts over, and wherever a cluster's ACMR is 
+already within threshold of the ACMR of the clusters it is split from. The 
+clusters are then sorted so that the ones that face away from the center of 
+the mesh, which are most likely to occlude others, are drawn first.
+
+*/
+
+void optimize_overdraw(unsigned int* indices, size_t index_count, const glm::vec3* positions, size_t vertex_count, float threshold = 1.05f)
+{
+	size_t triangle_count = index_count / 3;
+
+	if (triangle_count == 0)
+	{
+		return;
+	}
+
+	const size_t cache_size = 16;
+
+	// Find the hard boundaries, where every vertex of a triangle misses the
+	// cache.
+
+	std::vector<size_t> timestamps(vertex_count, 0);
+
+	size_t misses = cache_size + 1;
+
+	std::vector<size_t> hard_boundaries;
+
+	std::vector<int> triangle_misses(triangle_count);
+
+	for (size_t i = 0; i < triangle_count; i++)
+	{
+		triangle_misses[i] = 0;
+
+		for (int j = 0; j < 3; j++)
+		{
+			unsigned int vertex = indices[i * 3 + j];
+
+			if (misses - timestamps[vertex] > cache_size)
+			{
+				timestamps[vertex] = misses++;
+
+				triangle_misses[i]++;
+			}
+		}
+
+		if (i == 0 || triangle_misses[i] == 3)
+		{
+			hard_boundaries.push_back(i);
+		}
+	}
+
+	hard_boundaries.push_back(triangle_count);
+
+	// Split every hard cluster into soft clusters, starting over with an 
+	// empty cache at the start of each soft cluster. A soft cluster ends as 
+	// soon as its ACMR is close to the ACMR of its hard cluster.
+
+	std::vector<size_t> boundaries;
+
+	for (size_t i = 0; i + 1 < hard_boundaries.size(); i++)
+	{
+		size_t start = hard_boundaries[i];
+		size_t end = hard_boundaries[i + 1];
+
+		int hard_misses = 0;
+
+		for (size_t j = start; j < end; j++)
+		{
+			hard_misses += triangle_misses[j];
+		}
+
+		float cluster_threshold = threshold * float(hard_misses) / float(end - start);
+
+		size_t cluster_start = start;
+
+		int cluster_misses = 0;
+
+		misses += cache_size + 1;
+
+		boundaries.push_back(start);
+
+		for (size_t j = start; j < end; j++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int vertex = indices[j * 3 + k];
+
+				if (misses - timestamps[vertex] > cache_size)
+				{
+					timestamps[vertex] = misses++;
+
+					cluster_misses++;
+				}
+			}
+
+			if (j + 1 < end && float(cluster_misses) / float(j + 1 - cluster_start) <= cluster_threshold)
+			{
+				cluster_start = j + 1;
+
+				cluster_misses = 0;
+
+				misses += cache_size + 1;
+
+				boundaries.push_back(cluster_start);
+			}
+		}
+	}
+
+	boundaries.push_back(triangle_count);
+
+	// Find the area weighted centroid and normal of every cluster, and the 
+	// centroid of the whole mesh.
+
+	size_t cluster_count = boundaries.size() - 1;
+
+	std::vector<glm::vec3> cluster_centroids(cluster_count, glm::vec3(0.0f));
+	std::vector<glm::vec3> cluster_normals(cluster_count, glm::vec3(0.0f));
+
+	glm::vec3 mesh_centroid = glm::vec3(0.0f);
+
+	float mesh_area = 0.0f;
+
+	for (size_t i = 0; i < cluster_count; i++)
+	{
+		float cluster_area = 0.0f;
+
+		for (size_t j = boundaries[i]; j < boundaries[i + 1]; j++)
+		{
+			glm::vec3 p_0 = positions[indices[j * 3 + 0]];
+			glm::vec3 p_1 = positions[indices[j * 3 + 1]];
+			glm::vec3 p_2 = positions[indices[j * 3 + 2]];
+
+			glm::vec3 normal = glm::cross(p_1 - p_0, p_2 - p_0);
+
+			float area = glm::length(normal);
+
+			cluster_centroids[i] += (p_0 + p_1 + p_2) * (area / 3.0f);
+
+			cluster_normals[i] += normal;
+
+			cluster_area += area;
+		}
+
+		mesh_centroid += cluster_centroids[i];
+
+		mesh_area += cluster_area;
+
+		cluster_centroids[i] /= std::max(cluster_area, 1e-30f);
+	}
+
+	mesh_centroid /= std::max(mesh_area, 1e-30f);
+
+	// Sort the clusters by how far they face away from the mesh's centroid.
+
+	std::vector<float> cluster_keys(cluster_count);
+
+	std::vector<size_t> cluster_order(cluster_count);
+
+	for (size_t i = 0; i < cluster_count; i++)
+	{
+		float normal_length = glm::length(cluster_normals[i]);
+
+		glm::vec3 normal = normal_length > 0.0f ? cluster_normals[i] / normal_length : glm::vec3(0.0f);
+
+		cluster_keys[i] = glm::dot(cluster_centroids[i] - mesh_centroid, normal);
+
+		cluster_order[i] = i;
+	}
+
+	std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](size_t a, size_t b)
+	{
+		return cluster_keys[a] > cluster_keys[b];
+	});
+
+	// Write the clusters in their new order.
+
+	std::vector<unsigned int> output;
+
+	output.reserve(triangle_count * 3);
+
+	for (size_t i = 0; i < cluster_count; i++)
+	{
+		size_t cluster = cluster_order[i];
+
+		output.insert(output.end(), indices + boundaries[cluster] * 3, indices + boundaries[cluster + 1] * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+/*
+
+Reorder a range of the triangles of a larger mesh with optimize_vertex_cache
+and then optimize_overdraw. The vertices that the range uses are numbered from
+0 first, so that the work and memory depend on the size of the range instead 
+of the size of the whole mesh. Neither optimisation depends on how the 
+vertices are numbered.
+
+*/
+
+void optimize_triangle_order(unsigned int* indices, size_t index_count, const glm::vec3* positions)
+{
+	if (index_count < 3)
+	{
+		return;
+	}
+
+	// Number the vertices in the order they first appear, through an open
+	// addressing hash table with at least as many slots as indices.
+
+	int table_bits = 1;
+
+	while ((size_t(1) << table_bits) < index_count)
+	{
+		table_bits++;
+	}
+
+	std::vector<unsigned int> table_vertices(size_t(1) << table_bits);
+
+	std::vector<int> table_local_vertices(size_t(1) << table_bits, -1);
+
+	std::vector<unsigned int> local_vertices;
+
+	std::vector<unsigned int> local_indices(index_count);
+
+	for (size_t i = 0; i < index_count; i++)
+	{
+		unsigned int vertex = indices[i];
+
+		size_t slot = uint32_t(vertex * 2654435761u) >> (32 - table_bits);
+
+		while (table_local_vertices[slot] >= 0 && table_vertices[slot] != vertex)
+		{
+			slot = (slot + 1) & ((size_t(1) << table_bits) - 1);
+		}
+
+		if (table_local_vertices[slot] < 0)
+		{
+			table_vertices[slot] = vertex;
+
+			table_local_vertices[slot] = local_vertices.size();
+
+			local_vertices.push_back(vertex);
+		}
+
+		local_indices[i] = table_local_vertices[slot];
+	}
+
+	std::vector<glm::vec3> local_positions(local_vertices.size());
+
+	for (size_t i = 0; i < local_vertices.size(); i++)
+	{
+		local_positions[i] = positions[local_vertices[i]];
+	}
+
+	optimize_vertex_cache(&local_indices[0], index_count, local_vertices.size());
+
+	optimize_overdraw(&local_indices[0], index_count, &local_positions[0], local_vertices.size());
+
+	for (size_t i = 0; i < index_count; i++)
+	{
+		indices[i] = local_vertices[local_indices[i]];
+	}
+}
+
+/*
+
+A mesh_chunk describes one glDrawElementsBaseVertex call. Chunks that contain
+at most 65536 vertices use 16-bit indices, larger chunks use 32-bit indices. 
+Meshlets always use 16-bit indices. They would fit in 8 bits, but many GPUs 
+do not support 8-bit indices natively, and their drivers convert them.
+
+*/
+
+struct mesh_chunk
+{
+	// The type of the chunk's indices, either GL_UNSIGNED_SHORT or 
+	// GL_UNSIGNED_INT.
+
+	GLenum index_type;
+
+	// The amount of indices in the chunk.
+
+	GLsizei index_count;
+
+	// The offset of the chunk's first index in the element buffer, in bytes.
+
+	size_t index_offset;
+
+	// The index of the chunk's first vertex in the vertex buffer. The chunk's
+	// indices are relative to this vertex.
+
+	GLint base_vertex;
+};
+
+/*
+
+A chunked_mesh is an indexed_mesh that has been split into mesh_chunks, ready
+to be uploaded to a vertex buffer and an element buffer.
+
+*/
+
+struct chunked_mesh
+{
+	// For each vertex in the vertex buffer, the index of the vertex in the
+	// source indexed_mesh that it was copied from. Vertices on the border of
+	// two chunks are copied once into each chunk.
+
+	std::vector<unsigned int> vertex_sources;
+
+	// The contents of the element buffer. 16-bit and 32-bit indices may be
+	// mixed, every chunk starts on a 4 byte boundary.
+
+	std::vector<unsigned char> index_data;
+
+	// The chunks, in the order that they are stored in both buffers.
+
+	std::vector<mesh_chunk> chunks;
+};
+
+/*
+
+Split an indexed_mesh into chunks of consecutive triangles, where chunk i 
+ends before triangle chunk_ends[i]. Empty chunks are left out. Each chunk gets
+its own range of the vertex buffer, so that its indices can be stored with 16
+bits whenever it references at most 65536 vertices.
+
+*/
+
+chunked_mesh create_mesh_chunks(const indexed_mesh& mesh, const std::vector<size_t>& chunk_ends)
+{
+	chunked_mesh result;
+
+	// Map each vertex of the source mesh to its index inside the current 
+	// chunk, or -1 if the current chunk does not reference it yet.
+
+	std::vector<int> chunk_vertex_index(mesh.vertices.size(), -1);
+
+	std::vector<unsigned int> chunk_indices;
+
+	for (size_t j = 0; j < chunk_ends.size(); j++)
+	{
+		size_t first = j > 0 ? chunk_ends[j - 1] * 3 : 0;
+
+		size_t last = chunk_ends[j] * 3;
+
+		if (first == last)
+		{
+			continue;
+		}
+
+		// Remap the chunk's indices to a local range of vertices.
+
+		mesh_chunk chunk;
+
+		chunk.base_vertex = result.vertex_sources.size();
+
+		chunk_indices.clear();
+
+		for (size_t i = first; i < last; i++)
+		{
+			unsigned int vertex = mesh.indices[i];
+
+			if (chunk_vertex_index[vertex] < 0)
+			{
+				chunk_vertex_index[vertex] = result.vertex_sources.size() - chunk.base_vertex;
+
+				result.vertex_sources.push_back(vertex);
+			}
+
+			chunk_indices.push_back(chunk_vertex_index[vertex]);
+		}
+
+		// Forget the local indices of the chunk's vertices, so that the next
+		// chunk starts from scratch.
+
+		for (size_t i = chunk.base_vertex; i < result.vertex_sources.size(); i++)
+		{
+			chunk_vertex_index[result.vertex_sources[i]] = -1;
+		}
+
+		// Store the chunk's indices with the smallest type that can hold 
+		// them.
+
+		size_t chunk_vertex_count = result.vertex_sources.size() - chunk.base_vertex;
+
+		chunk.index_count = chunk_indices.size();
+
+		chunk.index_offset = (result.index_data.size() + 3) & ~size_t(3);
+
+		if (chunk_vertex_count <= 65536)
+		{
+			chunk.index_type = GL_UNSIGNED_SHORT;
+
+			result.index_data.resize(chunk.index_offset + chunk_indices.size() * sizeof(uint16_t));
+
+			uint16_t* chunk_data = (uint16_t*)&result.index_data[chunk.index_offset];
+
+			for (size_t i = 0; i < chunk_indices.size(); i++)
+			{
+				chunk_data[i] = chunk_indices[i];
+			}
+		}
+		else
+		{
+			chunk.index_type = GL_UNSIGNED_INT;
+
+			result.index_data.resize(chunk.index_offset + chunk_indices.size() * sizeof(uint32_t));
+
+			memcpy(&result.index_data[chunk.index_offset], &chunk_indices[0], chunk_indices.size() * sizeof(uint32_t));
+		}
+
+		result.chunks.push_back(chunk);
+	}
+
+	return result;
+}
+
+/*
+
+Group a list of indexed triangles into meshlets of at most max_vertices unique
+vertices and max_triangles triangles. Each meshlet is grown from the first 
+triangle that is not in a meshlet yet, by adding the triangle next to the 
+meshlet that adds the fewest new vertices, so that meshlets stay compact. The 
+indices are reordered so that each meshlet's triangles are contiguous, and the
+index of the first triangle after each meshlet is added to meshlet_ends.
+
+*/
+
+void build_meshlets(unsigned int* indices, size_t index_count, size_t max_vertices, size_t max_triangles, std::vector<size_t>& meshlet_ends)
+{
+	size_t triangle_count = index_count / 3;
+
+	// Give the vertices local indices, so that the lists below only need one
+	// entry per vertex that is actually used.
+
+	std::vector<unsigned int> vertices(indices, indices + triangle_count * 3);
+
+	std::sort(vertices.begin(), vertices.end());
+
+	vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+
+	std::vector<unsigned int> local_indices(triangle_count * 3);
+
+	for (size_t i = 0; i < triangle_count * 3; i++)
+	{
+		local_indices[i] = std::lower_bound(vertices.begin(), vertices.end(), indices[i]) - vertices.begin();
+	}
+
+	// Build the lists of triangles that use each vertex.
+
+	std::vector<size_t> first_triangle(vertices.size() + 1, 0);
+
+	for (size_t i = 0; i < triangle_count * 3; i++)
+	{
+		first_triangle[local_indices[i] + 1]++;
+	}
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		first_triangle[i + 1] += first_triangle[i];
+	}
+
+	std::vector<unsigned int> vertex_triangles(triangle_count * 3);
+
+	std::vector<size_t> filled(first_triangle.begin(), first_triangle.end() - 1);
+
+	for (size_t i = 0; i < triangle_count * 3; i++)
+	{
+		vertex_triangles[filled[local_indices[i]]++] = i / 3;
+	}
+
+	// Grow the meshlets.
+
+	std::vector<bool> used(triangle_count, false);
+
+	std::vector<int> meshlet_id(vertices.size(), -1);
+
+	std::vector<unsigned int> candidates;
+
+	std::vector<unsigned int> output;
+
+	output.reserve(triangle_count * 3);
+
+	size_t next_seed = 0;
+
+	int meshlet = 0;
+
+	while (true)
+	{
+		while (next_seed < triangle_count && used[next_seed])
+		{
+			next_seed++;
+		}
+
+		if (next_seed == triangle_count)
+		{
+			break;
+		}
+
+		size_t meshlet_vertices = 0;
+		size_t meshlet_triangles = 0;
+
+		candidates.assign(1, next_seed);
+
+		while (meshlet_triangles < max_triangles)
+		{
+			// Drop the candidates that were used in the meantime, keeping 
+			// the others in the order they were found. Then find the 
+			// candidate that adds the fewest new vertices, preferring older 
+			// candidates, so that the meshlet grows evenly around its seed.
+
+			candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](unsigned int triangle)
+			{
+				return used[triangle];
+			}), candidates.end());
+
+			int best = -1;
+
+			size_t best_cost = 4;
+
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				const unsigned int* triangle = &local_indices[candidates[i] * 3];
+
+				size_t cost = 0;
+
+				for (int j = 0; j < 3; j++)
+				{
+					cost += meshlet_id[triangle[j]] != meshlet;
+				}
+
+				if (cost < best_cost)
+				{
+					best = i;
+
+					best_cost = cost;
+				}
+			}
+
+			if (best < 0 || meshlet_vertices + best_cost > max_vertices)
+			{
+				break;
+			}
+
+			// Add the candidate to the meshlet, and its vertices' triangles to
+			// the candidates.
+
+			unsigned int triangle = candidates[best];
+
+			used[triangle] = true;
+
+			meshlet_triangles++;
+
+			for (int j = 0; j < 3; j++)
+			{
+				unsigned int vertex = local_indices[triangle * 3 + j];
+
+				output.push_back(indices[triangle * 3 + j]);
+
+				if (meshlet_id[vertex] != meshlet)
+				{
+					meshlet_id[vertex] = meshlet;
+
+					meshlet_vertices++;
+
+					for (size_t k = first_triangle[vertex]; k < first_triangle[vertex + 1]; k++)
+					{
+						if (!used[vertex_triangles[k]])
+						{
+							candidates.push_back(vertex_triangles[k]);
+						}
+					}
+				}
+			}
+		}
+
+		meshlet_ends.push_back(output.size() / 3);
+
+		meshlet++;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+/*
+
+Split an indexed_mesh into meshlets of at most max_vertices vertices and 
+max_triangles triangles. Each meshlet becomes a mesh_chunk with 16-bit 
+indices, so max_vertices must be at most 65536. The triangles are split into 
+groups, where group i ends before triangle group_ends[i], which are grouped 
+into meshlets separately and in parallel. These are usually the faces of the 
+base mesh, whose triangles are contiguous in every icosphere.
+
+*/
+
+chunked_mesh create_meshlets(indexed_mesh& mesh, size_t max_vertices, size_t max_triangles, const std::vector<size_t>& group_ends)
+{
+	size_t group_count = group_ends.size();
+
+	std::vector<std::vector<size_t>> group_meshlet_ends(group_count);
+
+	get_thread_pool().parallel_for(group_count, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			size_t group_first = i > 0 ? group_ends[i - 1] * 3 : 0;
+
+			size_t group_end = group_ends[i] * 3;
+
+			build_meshlets(&mesh.indices[0] + group_first, group_end - group_first, max_vertices, max_triangles, group_meshlet_ends[i]);
+		}
+	});
+
+	// Copy the meshlets into their own ranges of the vertex buffer and the 
+	// element buffer.
+
+	chunked_mesh result;
+
+	std::vector<int> chunk_vertex_index(mesh.vertices.size(), -1);
+
+	for (size_t i = 0; i < group_count; i++)
+	{
+		size_t group_first = i > 0 ? group_ends[i - 1] * 3 : 0;
+
+		size_t first = group_first;
+
+		for (size_t j = 0; j < group_meshlet_ends[i].size(); j++)
+		{
+			size_t last = group_first + group_meshlet_ends[i][j] * 3;
+
+			mesh_chunk chunk;
+
+			chunk.index_type = GL_UNSIGNED_SHORT;
+
+			chunk.index_count = last - first;
+
+			chunk.index_offset = (result.index_data.size() + 3) & ~size_t(3);
+
+			chunk.base_vertex = result.vertex_sources.size();
+
+			result.index_data.resize(chunk.index_offset + chunk.index_count * sizeof(uint16_t));
+
+			uint16_t* chunk_data = (uint16_t*)&result.index_data[chunk.index_offset];
+
+			for (size_t k = first; k < last; k++)
+			{
+				unsigned int vertex = mesh.indices[k];
+
+				if (chunk_vertex_index[vertex] < 0)
+				{
+					chunk_vertex_index[vertex] = result.vertex_sources.size() - chunk.base_vertex;
+
+					result.vertex_sources.push_back(vertex);
+				}
+
+				chunk_data[k - first] = chunk_vertex_index[vertex];
+			}
+
+			for (size_t k = chunk.base_vertex; k < result.vertex_sources.size(); k++)
+			{
+				chunk_vertex_index[result.vertex_sources[k]] = -1;
+			}
+
+			result.chunks.push_back(chunk);
+
+			first = last;
+		}
+	}
+
+	return result;
+}
+
+/*
+
+The bounds of a meshlet. The bounding sphere contains all of its vertices, 
+and the normal cone contains the normals of all of its triangles. The cone is
+stored as its axis and the sine of its half angle, or 1 if the cone is too 
+wide to ever cull the meshlet.
+
+*/
+
+struct meshlet_bounds
+{
+	glm::vec3 center;
+
+	float radius;
+
+	glm::vec3 cone_axis;
+
+	float cone_cutoff;
+};
+
+/*
+
+Find the bounds of every mesh_chunk of a chunked_mesh whose vertex buffer holds
+9 floats per vertex, starting with the position. The chunks must use 16-bit 
+indices, as made by create_meshlets.
+
+*/
+
+std::vector<meshlet_bounds> get_meshlet_bounds(const chunked_mesh& mesh, const float* vertices)
+{
+	std::vector<meshlet_bounds> bounds(mesh.chunks.size());
+
+	get_thread_pool().parallel_for(mesh.chunks.size(), 256, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const mesh_chunk& chunk = mesh.chunks[i];
+
+			const uint16_t* indices = (const uint16_t*)&mesh.index_data[chunk.index_offset];
+
+			// Find the bounding sphere around the center of the bounding box.
+
+			glm::vec3 minimum = glm::vec3(+INFINITY);
+			glm::vec3 maximum = glm::vec3(-INFINITY);
+
+			for (GLsizei j = 0; j < chunk.index_count; j++)
+			{
+				const float* vertex = vertices + (chunk.base_vertex + indices[j]) * 9;
+
+				minimum = glm::min(minimum, glm::vec3(vertex[0], vertex[1], vertex[2]));
+				maximum = glm::max(maximum, glm::vec3(vertex[0], vertex[1], vertex[2]));
+			}
+
+			bounds[i].center = (minimum + maximum) * 0.5f;
+
+			bounds[i].radius = 0.0f;
+
+			for (GLsizei j = 0; j < chunk.index_count; j++)
+			{
+				const float* vertex = vertices + (chunk.base_vertex + indices[j]) * 9;
+
+				bounds[i].radius = std::max(bounds[i].radius, glm::length(glm::vec3(vertex[0], vertex[1], vertex[2]) - bounds[i].center));
+			}
+
+			// Find the normal cone. Its axis is the average of the normals of
+			// the triangles, and its half angle is the largest angle between 
+			// the axis and a normal.
+
+			std::vector<glm::vec3> normals;
+
+			glm::vec3 axis = glm::vec3(0.0f);
+
+			for (GLsizei j = 0; j < chunk.index_count; j += 3)
+			{
+				glm::vec3 p[3];
+
+				for (int k = 0; k < 3; k++)
+				{
+					const float* vertex = vertices + (chunk.base_vertex + indices[j + k]) * 9;
+
+					p[k] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+				}
+
+				glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+				float length = glm::length(normal);
+
+				if (length > 0.0f)
+				{
+					normals.push_back(normal / length);
+
+					axis += normals.back();
+				}
+			}
+
+			float axis_length = glm::length(axis);
+
+			bounds[i].cone_axis = axis_length > 0.0f ? axis / axis_length : glm::vec3(0.0f, 0.0f, 1.0f);
+
+			float min_dot = 1.0f;
+
+			for (size_t j = 0; j < normals.size(); j++)
+			{
+				min_dot = std::min(min_dot, glm::dot(normals[j], bounds[i].cone_axis));
+			}
+
+			bounds[i].cone_cutoff = min_dot > 0.1f ? std::sqrt(1.0f - min_dot * min_dot) : 1.0f;
+		}
+	});
+
+	return bounds;
+}
+
+/*
+
+Return whether every triangle of a meshlet faces away from a camera. This is 
+conservative, so meshlets that are only partly facing away are never culled.
+
+*/
+
+bool is_meshlet_backfacing(const meshlet_bounds& bounds, glm::vec3 camera_position)
+{
+	glm::vec3 view = bounds.center - camera_position;
+
+	return glm::dot(view, bounds.cone_axis) >= bounds.cone_cutoff * glm::length(view) + bounds.radius;
+}
+
+/*
+
+A compact_vertex is the quantised form of the 9 float vertices of the 
+icosphere, 12 bytes instead of 36. The position is stored as an octahedral 
+encoded direction from the center of the planet and a height above the unit 
+sphere, the normal is octahedral encoded too and the color is stored with 8 
+bits per channel. compact_vertex.glsl decodes it.
+
+*/
+
+struct compact_vertex
+{
+	// The direction of the vertex from the center of the planet, octahedral
+	// encoded and scaled to [-32767, 32767].
+
+	int16_t direction[2];
+
+	// The height of the vertex above the unit sphere, scaled from 
+	// [0, compact_height_range] to [0, 65535].
+
+	uint16_t height;
+
+	// The normal of the vertex, octahedral encoded and scaled to [-127, 127].
+
+	int8_t normal[2];
+
+	// The color of the vertex. The alpha channel is unused.
+
+	uint8_t color[4];
+};
+
+// The largest height above the unit sphere that a compact_vertex can hold. 
+// Terrain is at most about 0.15 high, a step of the quantised height is about
+// 0.000004.
+
+const float compact_height_range = 0.25f;
+
+/*
+
+Map a unit vector onto the octahedron |x| + |y| + |z| = 1, and unfold the 
+octahedron's lower half over the corners of its upper half, so that the unit
+vector becomes a point in the square [-1, 1] x [-1, 1].
+
+*/
+
+glm::vec2 encode_octahedral(glm::vec3 vector)
+{
+	vector = vector * (1.0f / (std::fabs(vector.x) + std::fabs(vector.y) + std::fabs(vector.z)));
+
+	if (vector.z < 0.0f)
+	{
+		float x = (1.0f - std::fabs(vector.y)) * (vector.x >= 0.0f ? 1.0f : -1.0f);
+		float y = (1.0f - std::fabs(vector.x)) * (vector.y >= 0.0f ? 1.0f : -1.0f);
+
+		return glm::vec2(x, y);
+	}
+
+	return glm::vec2(vector.x, vector.y);
+}
+
+/*
+
+Invert encode_octahedral. This is the same as decode_octahedral in 
+compact_vertex.glsl.
+
+*/
+
+glm::vec3 decode_octahedral(glm::vec2 encoded)
+{
+	glm::vec3 vector = glm::vec3(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+
+	float fold = std::max(-vector.z, 0.0f);
+
+	vector.x += vector.x >= 0.0f ? -fold : fold;
+	vector.y += vector.y >= 0.0f ? -fold : fold;
+
+	return glm::normalize(vector);
+}
+
+/*
+
+Quantise the octahedral encoding of a unit vector to integers in 
+[-scale, scale]. Of the 4 integer points around the encoding, the one that 
+decodes closest to the vector is chosen.
+
+*/
+
+template <typename integer_type>
+void quantize_octahedral(glm::vec3 vector, integer_type* quantized, float scale)
+{
+	glm::vec2 encoded = encode_octahedral(vector) * scale;
+
+	float best_dot = -2.0f;
+
+	for (int i = 0; i < 4; i++)
+	{
+		float x = i & 1 ? std::ceil(encoded.x) : std::floor(encoded.x);
+		float y = i & 2 ? std::ceil(encoded.y) : std::floor(encoded.y);
+
+		float dot = glm::dot(decode_octahedral(glm::vec2(x, y) * (1.0f / scale)), vector);
+
+		if (dot > best_dot)
+		{
+			best_dot = dot;
+
+			quantized[0] = integer_type(x);
+			quantized[1] = integer_type(y);
+		}
+	}
+}
+
+/*
+
+Convert vertices with 9 floats each (position, color and normal) to 
+compact_vertices.
+
+*/
+
+std::vector<compact_vertex> create_compact_vertices(const float* vertices, size_t vertex_count)
+{
+	std::vector<compact_vertex> compact_vertices(vertex_count);
+
+	get_thread_pool().parallel_for(vertex_count, 4096, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const float* vertex = vertices + i * 9;
+
+			compact_vertex& compact = compact_vertices[i];
+
+			glm::vec3 position = glm::vec3(vertex[0], vertex[1], vertex[2]);
+
+			float radius = glm::length(position);
+
+			quantize_octahedral(position * (1.0f / radius), compact.direction, 32767.0f);
+
+			float height = std::min(std::max(radius - 1.0f, 0.0f), compact_height_range);
+
+			compact.height = uint16_t(height / compact_height_range * 65535.0f + 0.5f);
+
+			quantize_octahedral(glm::normalize(glm::vec3(vertex[6], vertex[7], vertex[8])), compact.normal, 127.0f);
+
+			for (int j = 0; j < 3; j++)
+			{
+				compact.color[j] = uint8_t(std::min(std::max(vertex[3 + j], 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+
+			compact.color[3] = 255;
+		}
+	});
+
+	return compact_vertices;
+}
+
+/*
+
+A planet_cache_key identifies the inputs that a cached planet was generated 
+from. Planets are only loaded from a cache with an identical key.
+
+*/
+
+struct planet_cache_key
+{
+	// The amount of subdivisions of the icosphere.
+
+	uint32_t subdivisions;
+
+	// Whether the icosphere is indexed or a triangle soup.
+
+	uint32_t indexed;
+
+	// The seed of the noise modules.
+
+	int32_t seed;
+
+	// Reserved, always zero.
+
+	uint32_t reserved;
+
+	// A hash of every other parameter of the noise modules and of the color
+	// gradient.
+
+	uint64_t parameter_hash;
+};
+
+/*
+
+A mesh_chunk as it is stored in a planet cache file. mesh_chunk has padding
+at its end, which would be written to the file uninitialized, so its fields 
+are copied into this struct, which has none.
+
+*/
+
+struct planet_cache_chunk
+{
+	uint32_t index_type;
+
+	uint32_t index_count;
+
+	uint64_t index_offset;
+
+	int32_t base_vertex;
+
+	// Reserved, always zero.
+
+	uint32_t reserved;
+};
+
+/*
+
+The header at the start of a planet cache file. It is followed by the 
+interleaved vertex buffer, in the format it is uploaded in, the element 
+buffer, the mesh_chunks of the icosphere (as planet_cache_chunks) and the 
+meshlet_bounds of its meshlets, if it has any.
+
+*/
+
+struct planet_cache_header
+{
+	// Always "PLANET" followed by two null characters.
+
+	char magic[8];
+
+	// The version of the cache format and of the code that generates planets.
+	// Increase planet_cache_version whenever either changes.
+
+	uint32_t version;
+
+	// Always 0x01020304, to reject caches written on a machine with a 
+	// different byte order.
+
+	uint32_t byte_order;
+
+	// The size of a planet_cache_chunk on the machine that wrote the cache.
+
+	uint32_t chunk_size;
+
+	// The size of a vertex, 9 floats or a compact_vertex.
+
+	uint32_t vertex_size;
+
+	planet_cache_key key;
+
+	// The amount of vertices, the size of the element buffer in bytes, the 
+	// amount of mesh_chunks and the amount of meshlet_bounds.
+
+	uint64_t vertex_count;
+
+	uint64_t index_data_size;
+
+	uint64_t chunk_count;
+
+	uint64_t bounds_count;
+};
+
+const uint32_t planet_cache_version = 4;
+
+/*
+
+Combine a hash with the bytes of an object using FNV-1a.
+
+*/
+
+template <typename object_type>
+uint64_t hash_object(uint64_t hash, const object_type& object)
+{
+	const unsigned char* bytes = (const unsigned char*)&object;
+
+	for (size_t i = 0; i < sizeof(object_type); i++)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+/*
+
+Create the planet_cache_key of a planet.
+
+*/
+
+planet_cache_key get_planet_cache_key(int subdivisions, bool indexed, bool optimized, bool meshlets, bool compact, bool cube_sphere, bool adaptive, bool ocean, int seed, const noise::module::Perlin& noise_1, const noise::module::RidgedMulti& noise_2, const noise::utils::GradientColor& color_map)
+{
+	planet_cache_key key;
+
+	key.subdivisions = subdivisions;
+
+	key.indexed = indexed;
+
+	key.seed = seed;
+
+	key.reserved = 0;
+
+	// Hash the parameters of the noise modules. Seeds are part of the key, so
+	// that a planet's cache file can be found from its seed alone.
+
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	hash = hash_object(hash, optimized);
+
+	hash = hash_object(hash, meshlets);
+
+	hash = hash_object(hash, compact);
+
+	hash = hash_object(hash, cube_sphere);
+
+	hash = hash_object(hash, adaptive);
+
+	hash = hash_object(hash, ocean);
+
+	hash = hash_object(hash, noise_1.GetSeed());
+	hash = hash_object(hash, noise_1.GetOctaveCount());
+	hash = hash_object(hash, noise_1.GetFrequency());
+	hash = hash_object(hash, noise_1.GetLacunarity());
+	hash = hash_object(hash, noise_1.GetPersistence());
+	hash = hash_object(hash, (int)noise_1.GetNoiseQuality());
+
+	hash = hash_object(hash, noise_2.GetSeed());
+	hash = hash_object(hash, noise_2.GetOctaveCount());
+	hash = hash_object(hash, noise_2.GetFrequency());
+	hash = hash_object(hash, noise_2.GetLacunarity());
+	hash = hash_object(hash, (int)noise_2.GetNoiseQuality());
+
+	// Hash the gradient points of the color gradient.
+
+	const noise::utils::GradientPoint* gradient_points = color_map.GetGradientPointArray();
+
+	for (int i = 0; i < color_map.GetGradientPointCount(); i++)
+	{
+		hash = hash_object(hash, gradient_points[i].pos);
+
+		hash = hash_object(hash, gradient_points[i].color.red);
+		hash = hash_object(hash, gradient_points[i].color.green);
+		hash = hash_object(hash, gradient_points[i].color.blue);
+		hash = hash_object(hash, gradient_points[i].color.alpha);
+	}
+
+	key.parameter_hash = hash;
+
+	return key;
+}
+
+/*
+
+Return the path of the cache file of a planet. Each key gets its own file, so
+that planets with different parameters do not overwrite each other.
+
+*/
+
+std::string get_planet_cache_path(const planet_cache_key& key)
+{
+	std::stringstream path;
+
+	path << "planet_" << key.seed << "_" << key.subdivisions << (key.indexed ? "i" : "s") << "_" << std::hex << key.parameter_hash << ".cache";
+
+	return path.str();
+}
+
+/*
+
+A mapped_file is a read-only view of a whole file. On POSIX systems the file
+is mapped with mmap, so pages are only read from disk (or the page cache) 
+once they are touched.
+
+*/
+
+struct mapped_file
+{
+	void* data;
+
+	size_t size;
+};
+
+/*
+
+Map a file into memory. Returns false if the file could not be opened.
+
+*/
+
+bool map_file(const std::string& path, mapped_file& file)
+{
+	file.data = NULL;
+	file.size = 0;
+
+	#ifndef _WIN32
+
+	int descriptor = open(path.c_str(), O_RDONLY);
+
+	if (descriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+
+	if (fstat(descriptor, &status) < 0 || status.st_size == 0)
+	{
+		close(descriptor);
+
+		return false;
+	}
+
+	void* data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+	// The mapping stays valid after the file is closed.
+
+	close(descriptor);
+
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	file.data = data;
+	file.size = status.st_size;
+
+	#else
+
+	std::ifstream stream(path.c_str(), std::ios::binary | std::ios::ate);
+
+	if (!stream.is_open())
+	{
+		return false;
+	}
+
+	file.size = stream.tellg();
+
+	file.data = malloc(file.size);
+
+	stream.seekg(0);
+
+	if (!stream.read((char*)file.data, file.size))
+	{
+		free(file.data);
+
+		file.data = NULL;
+		file.size = 0;
+
+		return false;
+	}
+
+	#endif
+
+	return true;
+}
+
+/*
+
+Unmap a file that was mapped using map_file.
+
+*/
+
+void unmap_file(mapped_file& file)
+{
+	if (file.data)
+	{
+		#ifndef _WIN32
+
+		munmap(file.data, file.size);
+
+		#else
+
+		free(file.data);
+
+		#endif
+	}
+
+	file.data = NULL;
+	file.size = 0;
+}
+
+/*
+
+Load a planet from its cache file. On success, vertices points to the 
+interleaved vertex buffer inside file, which must stay mapped for as long as
+the vertices are used, and the element buffer, mesh_chunks and meshlet_bounds
+are copied into chunks and bounds. Returns false if there is no valid cache 
+file for the key, or if its vertices are not vertex_size bytes each.
+
+*/
+
+bool load_planet_cache(const planet_cache_key& key, size_t vertex_size, mapped_file& file, const void*& vertices, size_t& vertex_count, chunked_mesh& chunks, std::vector<meshlet_bounds>& bounds)
+{
+	if (!map_file(get_planet_cache_path(key), file))
+	{
+		return false;
+	}
+
+	// Validate the header.
+
+	planet_cache_header header;
+
+	bool valid = file.size >= sizeof(planet_cache_header);
+
+	if (valid)
+	{
+		memcpy(&header, file.data, sizeof(planet_cache_header));
+
+		valid =
+		(
+			memcmp(header.magic, "PLANET\0\0", 8) == 0 &&
+
+			header.version == planet_cache_version &&
+
+			header.byte_order == 0x01020304 &&
+
+			header.chunk_size == sizeof(planet_cache_chunk) &&
+
+			header.vertex_size == vertex_size &&
+
+			memcmp(&header.key, &key, sizeof(planet_cache_key)) == 0
+		);
+	}
+
+	// Make sure the file is large enough to hold everything that the header
+	// describes.
+
+	size_t vertex_data_size = 0;
+	size_t chunk_data_size = 0;
+	size_t bounds_data_size = 0;
+
+	if (valid)
+	{
+		vertex_data_size = header.vertex_count * vertex_size;
+
+		chunk_data_size = header.chunk_count * sizeof(planet_cache_chunk);
+
+		bounds_data_size = header.bounds_count * sizeof(meshlet_bounds);
+
+		valid = file.size == sizeof(planet_cache_header) + vertex_data_size + header.index_data_size + chunk_data_size + bounds_data_size;
+	}
+
+	if (!valid)
+	{
+		unmap_file(file);
+
+		return false;
+	}
+
+	unsigned char* data = (unsigned char*)file.data + sizeof(planet_cache_header);
+
+	// Point at the vertex buffer, it is used straight from the mapping.
+
+	vertices = data;
+
+	vertex_count = header.vertex_count;
+
+	data += vertex_data_size;
+
+	// Copy the element buffer, the mesh_chunks and the meshlet_bounds.
+
+	chunks.vertex_sources.clear();
+
+	chunks.index_data.assign(data, data + header.index_data_size);
+
+	data += header.index_data_size;
+
+	chunks.chunks.resize(header.chunk_count);
+
+	for (size_t i = 0; i < header.chunk_count; i++)
+	{
+		planet_cache_chunk stored;
+
+		memcpy(&stored, data + i * sizeof(planet_cache_chunk), sizeof(planet_cache_chunk));
+
+		chunks.chunks[i].index_type = stored.index_type;
+
+		chunks.chunks[i].index_count = stored.index_count;
+
+		chunks.chunks[i].index_offset = stored.index_offset;
+
+		chunks.chunks[i].base_vertex = stored.base_vertex;
+	}
+
+	data += chunk_data_size;
+
+	bounds.resize(header.bounds_count);
+
+	if (bounds_data_size)
+	{
+		memcpy(&bounds[0], data, bounds_data_size);
+	}
+
+	return true;
+}
+
+/*
+
+Save a planet to its cache file, with vertices of vertex_size bytes each. The
+file is written under a temporary name and then renamed, so that a partially
+written cache is never loaded. Returns false if the file could not be written.
+
+*/
+
+bool save_planet_cache(const planet_cache_key& key, const void* vertices, size_t vertex_size, size_t vertex_count, const chunked_mesh& chunks, const std::vector<meshlet_bounds>& bounds)
+{
+	std::string path = get_planet_cache_path(key);
+
+	std::string temporary_path = path + ".tmp";
+
+	// Create the header.
+
+	planet_cache_header header;
+
+	memset(&header, 0, sizeof(planet_cache_header));
+
+	memcpy(header.magic, "PLANET\0\0", 8);
+
+	header.version = planet_cache_version;
+
+	header.byte_order = 0x01020304;
+
+	header.chunk_size = sizeof(planet_cache_chunk);
+
+	header.vertex_size = vertex_size;
+
+	header.key = key;
+
+	header.vertex_count = vertex_count;
+
+	header.index_data_size = chunks.index_data.size();
+
+	header.chunk_count = chunks.chunks.size();
+
+	header.bounds_count = bounds.size();
+
+	// Write the header, the vertex buffer, the element buffer, the 
+	// mesh_chunks and the meshlet_bounds.
+
+	std::ofstream stream(temporary_path.c_str(), std::ios::binary | std::ios::trunc);
+
+	if (!stream.is_open())
+	{
+		return false;
+	}
+
+	stream.write((const char*)&header, sizeof(planet_cache_header));
+
+	stream.write((const char*)vertices, vertex_count * vertex_size);
+
+	if (header.index_data_size)
+	{
+		stream.write((const char*)&chunks.index_data[0], header.index_data_size);
+	}
+
+	for (size_t i = 0; i < header.chunk_count; i++)
+	{
+		planet_cache_chunk stored;
+
+		stored.index_type = chunks.chunks[i].index_type;
+
+		stored.index_count = chunks.chunks[i].index_count;
+
+		stored.index_offset = chunks.chunks[i].index_offset;
+
+		stored.base_vertex = chunks.chunks[i].base_vertex;
+
+		stored.reserved = 0;
+
+		stream.write((const char*)&stored, sizeof(planet_cache_chunk));
+	}
+
+	if (header.bounds_count)
+	{
+		stream.write((const char*)&bounds[0], header.bounds_count * sizeof(meshlet_bounds));
+	}
+
+	stream.close();
+
+	if (stream.fail() || std::rename(temporary_path.c_str(), path.c_str()) != 0)
+	{
+		std::remove(temporary_path.c_str());
+
+		return false;
+	}
+
+	return true;
+}
+
+/*
+
+Create the gradient vectors of libnoise's gradient noise, already multiplied 
+by 2.12 (the scale that libnoise applies to every gradient dot product), as 4
+doubles per vector. libnoise does not expose its table, but 
+noise::GradientNoise3D at a unit offset from a lattice point returns one 
+component of the lattice point's scaled vector. Lattice points along the x 
+axis are tried until all 256 vectors have been found (it takes 790 points).
+
+*/
+
+std::vector<double> create_gradient_vectors()
+{
+	std::vector<double> gradients(256 * 4, 0.0);
+
+	std::vector<bool> found(256, false);
+
+	int found_count = 0;
+
+	for (int i = 0; found_count < 256; i++)
+	{
+		// The vector index of (i, 0, 0) with seed 0, the same way as 
+		// noise::GradientNoise3D finds it.
+
+		uint32_t hash = uint32_t(1619) * uint32_t(i);
+
+		int index = (hash ^ (hash >> 8)) & 0xFF;
+
+		if (found[index])
+		{
+			continue;
+		}
+
+		found[index] = true;
+
+		found_count++;
+
+		gradients[index * 4 + 0] = noise::GradientNoise3D(i + 1.0, 0.0, 0.0, i, 0, 0, 0);
+		gradients[index * 4 + 1] = noise::GradientNoise3D(i + 0.0, 1.0, 0.0, i, 0, 0, 0);
+		gradients[index * 4 + 2] = noise::GradientNoise3D(i + 0.0, 0.0, 1.0, i, 0, 0, 0);
+	}
+
+	return gradients;
+}
+
+/*
+
+Return the gradient vectors from create_gradient_vectors, which are created
+the first time they are needed.
+
+*/
+
+const double* get_gradient_vectors()
+{
+	static const std::vector<double> gradients = create_gradient_vectors();
+
+	return &gradients[0];
+}
+
+/*
+
+Return the spectral weights of a RidgedMulti, which it keeps to itself. They
+are found the same way as RidgedMulti::CalcSpectralWeights does.
+
+*/
+
+std::array<double, 30> get_ridged_multi_spectral_weights(const noise::module::RidgedMulti& module)
+{
+	std::array<double, 30> weights;
+
+	double frequency = 1.0;
+
+	for (int i = 0; i < 30; i++)
+	{
+		weights[i] = std::pow(frequency, -1.0);
+
+		frequency *= module.GetLacunarity();
+	}
+
+	return weights;
+}
+
+#ifdef PLANET_NOISE_SIMD
+
+/*
+
+Evaluate the dot products between the gradient vectors at 4 lattice points 
+(found from their hashes) and the offsets of 4 points from them, with AVX2. 
+
+*/
+
+__attribute__((target("avx2")))
+inline __m256d get_gradient_dot_avx2(__m128i hash, __m256d x, __m256d y, __m256d z, const double* gradients)
+{
+	__m128i index = _mm_slli_epi32(_mm_and_si128(_mm_xor_si128(hash, _mm_srli_epi32(hash, 8)), _mm_set1_epi32(0xFF)), 2);
+
+	// The masked gathers, with every lane enabled, are used because the 
+	// unmasked ones start from an undefined vector, which -Wuninitialized 
+	// warns about.
+
+	__m256d zero = _mm256_setzero_pd();
+
+	__m256d mask = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+
+	__m256d gradient_x = _mm256_mask_i32gather_pd(zero, gradients + 0, index, mask, 8);
+	__m256d gradient_y = _mm256_mask_i32gather_pd(zero, gradients + 1, index, mask, 8);
+	__m256d gradient_z = _mm256_mask_i32gather_pd(zero, gradients + 2, index, mask, 8);
+
+	return _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(gradient_x, x), _mm256_mul_pd(gradient_y, y)), _mm256_mul_pd(gradient_z, z));
+}
+
+/*
+
+Evaluate noise::GradientCoherentNoise3D at 4 points with AVX2. Every step is
+the same as in libnoise, in double precision and in the same order, except 
+that the gradient vectors are already scaled by 2.12. The points must be less
+than 2 ^ 30 away from the origin.
+
+*/
+
+__attribute__((target("avx2")))
+inline __m256d get_gradient_coherent_noise_avx2(__m256d x, __m256d y, __m256d z, int seed, noise::NoiseQuality quality, const double* gradients)
+{
+	__m256d zero = _mm256_setzero_pd();
+
+	__m256d one = _mm256_set1_pd(1.0);
+
+	// Find the lattice point below each point, which libnoise finds as 
+	// (int)x for positive x and as (int)x - 1 otherwise, and the offset of 
+	// the point from it.
+
+	__m256d x_0 = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m256d y_0 = _mm256_round_pd(y, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m256d z_0 = _mm256_round_pd(z, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+
+	x_0 = _mm256_sub_pd(x_0, _mm256_and_pd(_mm256_cmp_pd(x, zero, _CMP_LE_OQ), one));
+	y_0 = _mm256_sub_pd(y_0, _mm256_and_pd(_mm256_cmp_pd(y, zero, _CMP_LE_OQ), one));
+	z_0 = _mm256_sub_pd(z_0, _mm256_and_pd(_mm256_cmp_pd(z, zero, _CMP_LE_OQ), one));
+
+	__m256d x_d = _mm256_sub_pd(x, x_0);
+	__m256d y_d = _mm256_sub_pd(y, y_0);
+	__m256d z_d = _mm256_sub_pd(z, z_0);
+
+	// Find the interpolation weights.
+
+	__m256d x_s = x_d;
+	__m256d y_s = y_d;
+	__m256d z_s = z_d;
+
+	if (quality == noise::QUALITY_STD)
+	{
+		__m256d three = _mm256_set1_pd(3.0);
+		__m256d two = _mm256_set1_pd(2.0);
+
+		x_s = _mm256_mul_pd(_mm256_mul_pd(x_d, x_d), _mm256_sub_pd(three, _mm256_mul_pd(two, x_d)));
+		y_s = _mm256_mul_pd(_mm256_mul_pd(y_d, y_d), _mm256_sub_pd(three, _mm256_mul_pd(two, y_d)));
+		z_s = _mm256_mul_pd(_mm256_mul_pd(z_d, z_d), _mm256_sub_pd(three, _mm256_mul_pd(two, z_d)));
+	}
+	else if (quality == noise::QUALITY_BEST)
+	{
+		__m256d* weights[3] = {&x_s, &y_s, &z_s};
+
+		for (int i = 0; i < 3; i++)
+		{
+			__m256d a = *weights[i];
+
+			__m256d a_3 = _mm256_mul_pd(_mm256_mul_pd(a, a), a);
+			__m256d a_4 = _mm256_mul_pd(a_3, a);
+			__m256d a_5 = _mm256_mul_pd(a_4, a);
+
+			*weights[i] = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(6.0), a_5), _mm256_mul_pd(_mm256_set1_pd(15.0), a_4)), _mm256_mul_pd(_mm256_set1_pd(10.0), a_3));
+		}
+	}
+
+	// Hash the corners of the lattice cell. Integer overflow wraps around, 
+	// like it does in libnoise.
+
+	__m128i x_h_0 = _mm_mullo_epi32(_mm256_cvttpd_epi32(x_0), _mm_set1_epi32(1619));
+	__m128i y_h_0 = _mm_mullo_epi32(_mm256_cvttpd_epi32(y_0), _mm_set1_epi32(31337));
+	__m128i z_h_0 = _mm_mullo_epi32(_mm256_cvttpd_epi32(z_0), _mm_set1_epi32(6971));
+
+	z_h_0 = _mm_add_epi32(z_h_0, _mm_set1_epi32(int32_t(uint32_t(1013) * uint32_t(seed))));
+
+	__m128i x_h_1 = _mm_add_epi32(x_h_0, _mm_set1_epi32(1619));
+	__m128i y_h_1 = _mm_add_epi32(y_h_0, _mm_set1_epi32(31337));
+	__m128i z_h_1 = _mm_add_epi32(z_h_0, _mm_set1_epi32(6971));
+
+	__m256d x_d_1 = _mm256_sub_pd(x_d, one);
+	__m256d y_d_1 = _mm256_sub_pd(y_d, one);
+	__m256d z_d_1 = _mm256_sub_pd(z_d, one);
+
+	// Interpolate between the corners, in the same order as libnoise.
+
+	__m256d x_s_1 = _mm256_sub_pd(one, x_s);
+	__m256d y_s_1 = _mm256_sub_pd(one, y_s);
+	__m256d z_s_1 = _mm256_sub_pd(one, z_s);
+
+	__m256d n_0;
+	__m256d n_1;
+
+	n_0 = get_gradient_dot_avx2(_mm_add_epi32(_mm_add_epi32(x_h_0, y_h_0), z_h_0), x_d, y_d, z_d, gradients);
+	n_1 = get_gradient_dot_avx2(_mm_add_epi32(_mm_add_epi32(x_h_1, y_h_0), z_h_0), x_d_1, y_d, z_d, gradients);
+
+	__m256d i_x_0 = _mm256_add_pd(_mm256_mul_pd(x_s_1, n_0), _mm256_mul_pd(x_s, n_1));
+
+	n_0 = get_gradient_dot_avx2(_mm_add_epi32(_mm_add_epi32(x_h_0, y_h_1), z_h_0), x_d, y_d_1, z_d, gradients);
+	n_1 = get_gradient_dot_avx2(_mm_add_epi32(_mm_add_epi32(x_h_1, y_h_1), z_h_0), x_d_1, y_d_1, z_d, gradients);
+
+	__m256d i_x_1 = _mm256_add_pd(_mm256_mul_pd(x_s_1, n_0), _mm256_mul_pd(x_s, n_1));
+
+	__m256d i_y_0 = _mm256_add_pd(_mm256_mul_pd(y_s_1, i_x_0), _mm256_mul_pd(y_s, i_x_1));
+
+	n_0 = get_gradient_dot_avx2(_mm_add_epi32(_mm_add_epi32(x_h_0, y_h_0), z_h_1), x_d, y_d, z_d_1, gradients);
+	n_1 = get_gradient_dot_avx2(_mm_add_epi32(_mm_add_epi32(x_h_1, y_h_0), z_h_1), x_d_1, y_d, z_d_1, gradients);
+
+	i_x_0 = _mm256_add_pd(_mm256_mul_pd(x_s_1, n_0), _mm256_mul_pd(x_s, n_1));
+
+	n_0 = get_gradient_dot_avx2(_mm_add_epi32(_mm_add_epi32(x_h_0, y_h_1), z_h_1), x_d, y_d_1, z_d_1, gradients);
+	n_1 = get_gradient_dot_avx2(_mm_add_epi32(_mm_add_epi32(x_h_1, y_h_1), z_h_1), x_d_1, y_d_1, z_d_1, gradients);
+
+	i_x_1 = _mm256_add_pd(_mm256_mul_pd(x_s_1, n_0), _mm256_mul_pd(x_s, n_1));
+
+	__m256d i_y_1 = _mm256_add_pd(_mm256_mul_pd(y_s_1, i_x_0), _mm256_mul_pd(y_s, i_x_1));
+
+	return _mm256_add_pd(_mm256_mul_pd(z_s_1, i_y_0), _mm256_mul_pd(z_s, i_y_1));
+}
+
+/*
+
+Evaluate a Perlin module and a RidgedMulti module at count points with AVX2,
+4 at a time. count must be a multiple of 4.
+
+*/
+
+__attribute__((target("avx2")))
+void get_perlin_values_avx2(const noise::module::Perlin& module, const double* x, const double* y, const double* z, double* values, size_t count)
+{
+	const double* gradients = get_gradient_vectors();
+
+	__m256d frequency = _mm256_set1_pd(module.GetFrequency());
+
+	__m256d lacunarity = _mm256_set1_pd(module.GetLacunarity());
+
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m256d p_x = _mm256_mul_pd(_mm256_loadu_pd(x + i), frequency);
+		__m256d p_y = _mm256_mul_pd(_mm256_loadu_pd(y + i), frequency);
+		__m256d p_z = _mm256_mul_pd(_mm256_loadu_pd(z + i), frequency);
+
+		__m256d value = _mm256_setzero_pd();
+
+		double persistence = 1.0;
+
+		for (int octave = 0; octave < module.GetOctaveCount(); octave++)
+		{
+			__m256d signal = get_gradient_coherent_noise_avx2(p_x, p_y, p_z, (module.GetSeed() + octave) & 0xFFFFFFFF, module.GetNoiseQuality(), gradients);
+
+			value = _mm256_add_pd(value, _mm256_mul_pd(signal, _mm256_set1_pd(persistence)));
+
+			p_x = _mm256_mul_pd(p_x, lacunarity);
+			p_y = _mm256_mul_pd(p_y, lacunarity);
+			p_z = _mm256_mul_pd(p_z, lacunarity);
+
+			persistence *= module.GetPersistence();
+		}
+
+		_mm256_storeu_pd(values + i, value);
+	}
+}
+
+__attribute__((target("avx2")))
+void get_ridged_multi_values_avx2(const noise::module::RidgedMulti& module, const double* x, const double* y, const double* z, double* values, size_t count)
+{
+	const double* gradients = get_gradient_vectors();
+
+	std::array<double, 30> spectral_weights = get_ridged_multi_spectral_weights(module);
+
+	__m256d frequency = _mm256_set1_pd(module.GetFrequency());
+
+	__m256d lacunarity = _mm256_set1_pd(module.GetLacunarity());
+
+	__m256d sign = _mm256_set1_pd(-0.0);
+
+	__m256d one = _mm256_set1_pd(1.0);
+
+	__m256d two = _mm256_set1_pd(2.0);
+
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m256d p_x = _mm256_mul_pd(_mm256_loadu_pd(x + i), frequency);
+		__m256d p_y = _mm256_mul_pd(_mm256_loadu_pd(y + i), frequency);
+		__m256d p_z = _mm256_mul_pd(_mm256_loadu_pd(z + i), frequency);
+
+		__m256d value = _mm256_setzero_pd();
+
+		__m256d weight = one;
+
+		for (int octave = 0; octave < module.GetOctaveCount(); octave++)
+		{
+			__m256d signal = get_gradient_coherent_noise_avx2(p_x, p_y, p_z, (module.GetSeed() + octave) & 0x7FFFFFFF, module.GetNoiseQuality(), gradients);
+
+			// Make ridges, weight each octave by the one before it, and keep
+			// the weights between 0 and 1.
+
+			signal = _mm256_sub_pd(one, _mm256_andnot_pd(sign, signal));
+
+			signal = _mm256_mul_pd(_mm256_mul_pd(signal, signal), weight);
+
+			weight = _mm256_max_pd(_mm256_min_pd(_mm256_mul_pd(signal, two), one), _mm256_setzero_pd());
+
+			value = _mm256_add_pd(value, _mm256_mul_pd(signal, _mm256_set1_pd(spectral_weights[octave])));
+
+			p_x = _mm256_mul_pd(p_x, lacunarity);
+			p_y = _mm256_mul_pd(p_y, lacunarity);
+			p_z = _mm256_mul_pd(p_z, lacunarity);
+		}
+
+		_mm256_storeu_pd(values + i, _mm256_sub_pd(_mm256_mul_pd(value, _mm256_set1_pd(1.25)), one));
+	}
+}
+
+/*
+
+The same as get_gradient_dot_avx2, for 8 points with AVX-512.
+
+*/
+
+__attribute__((target("avx512f")))
+inline __m512d get_gradient_dot_avx512(__m256i hash, __m512d x, __m512d y, __m512d z, const double* gradients)
+{
+	__m256i index = _mm256_slli_epi32(_mm256_and_si256(_mm256_xor_si256(hash, _mm256_srli_epi32(hash, 8)), _mm256_set1_epi32(0xFF)), 2);
+
+	// The masked gathers are used for the same reason as in 
+	// get_gradient_dot_avx2.
+
+	__m512d zero = _mm512_setzero_pd();
+
+	__m512d gradient_x = _mm512_mask_i32gather_pd(zero, 0xFF, index, gradients + 0, 8);
+	__m512d gradient_y = _mm512_mask_i32gather_pd(zero, 0xFF, index, gradients + 1, 8);
+	__m512d gradient_z = _mm512_mask_i32gather_pd(zero, 0xFF, index, gradients + 2, 8);
+
+	return _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(gradient_x, x), _mm512_mul_pd(gradient_y, y)), _mm512_mul_pd(gradient_z, z));
+}
+
+/*
+
+The same as get_gradient_coherent_noise_avx2, for 8 points with AVX-512.
+
+*/
+
+__attribute__((target("avx512f")))
+inline __m512d get_gradient_coherent_noise_avx512(__m512d x, __m512d y, __m512d z, int seed, noise::NoiseQuality quality, const double* gradients)
+{
+	__m512d zero = _mm512_setzero_pd();
+
+	__m512d one = _mm512_set1_pd(1.0);
+
+	// Find the lattice point below each point, and the offset of the point 
+	// from it. The masked forms of the intrinsics below, with every lane 
+	// enabled, avoid the undefined vectors of the unmasked ones, which 
+	// -Wuninitialized warns about.
+
+	__m512d x_0 = _mm512_mask_roundscale_pd(zero, 0xFF, x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m512d y_0 = _mm512_mask_roundscale_pd(zero, 0xFF, y, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m512d z_0 = _mm512_mask_roundscale_pd(zero, 0xFF, z, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+
+	x_0 = _mm512_mask_sub_pd(x_0, _mm512_cmp_pd_mask(x, zero, _CMP_LE_OQ), x_0, one);
+	y_0 = _mm512_mask_sub_pd(y_0, _mm512_cmp_pd_mask(y, zero, _CMP_LE_OQ), y_0, one);
+	z_0 = _mm512_mask_sub_pd(z_0, _mm512_cmp_pd_mask(z, zero, _CMP_LE_OQ), z_0, one);
+
+	__m512d x_d = _mm512_sub_pd(x, x_0);
+	__m512d y_d = _mm512_sub_pd(y, y_0);
+	__m512d z_d = _mm512_sub_pd(z, z_0);
+
+	// Find the interpolation weights.
+
+	__m512d x_s = x_d;
+	__m512d y_s = y_d;
+	__m512d z_s = z_d;
+
+	if (quality == noise::QUALITY_STD)
+	{
+		__m512d three = _mm512_set1_pd(3.0);
+		__m512d two = _mm512_set1_pd(2.0);
+
+		x_s = _mm512_mul_pd(_mm512_mul_pd(x_d, x_d), _mm512_sub_pd(three, _mm512_mul_pd(two, x_d)));
+		y_s = _mm512_mul_pd(_mm512_mul_pd(y_d, y_d), _mm512_sub_pd(three, _mm512_mul_pd(two, y_d)));
+		z_s = _mm512_mul_pd(_mm512_mul_pd(z_d, z_d), _mm512_sub_pd(three, _mm512_mul_pd(two, z_d)));
+	}
+	else if (quality == noise::QUALITY_BEST)
+	{
+		__m512d* weights[3] = {&x_s, &y_s, &z_s};
+
+		for (int i = 0; i < 3; i++)
+		{
+			__m512d a = *weights[i];
+
+			__m512d a_3 = _mm512_mul_pd(_mm512_mul_pd(a, a), a);
+			__m512d a_4 = _mm512_mul_pd(a_3, a);
+			__m512d a_5 = _mm512_mul_pd(a_4, a);
+
+			*weights[i] = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(_mm512_set1_pd(6.0), a_5), _mm512_mul_pd(_mm512_set1_pd(15.0), a_4)), _mm512_mul_pd(_mm512_set1_pd(10.0), a_3));
+		}
+	}
+
+	// Hash the corners of the lattice cell.
+
+	__m256i x_h_0 = _mm256_mullo_epi32(_mm512_mask_cvttpd_epi32(_mm256_setzero_si256(), 0xFF, x_0), _mm256_set1_epi32(1619));
+	__m256i y_h_0 = _mm256_mullo_epi32(_mm512_mask_cvttpd_epi32(_mm256_setzero_si256(), 0xFF, y_0), _mm256_set1_epi32(31337));
+	__m256i z_h_0 = _mm256_mullo_epi32(_mm512_mask_cvttpd_epi32(_mm256_setzero_si256(), 0xFF, z_0), _mm256_set1_epi32(6971));
+
+	z_h_0 = _mm256_add_epi32(z_h_0, _mm256_set1_epi32(int32_t(uint32_t(1013) * uint32_t(seed))));
+
+	__m256i x_h_1 = _mm256_add_epi32(x_h_0, _mm256_set1_epi32(1619));
+	__m256i y_h_1 = _mm256_add_epi32(y_h_0, _mm256_set1_epi32(31337));
+	__m256i z_h_1 = _mm256_add_epi32(z_h_0, _mm256_set1_epi32(6971));
+
+	__m512d x_d_1 = _mm512_sub_pd(x_d, one);
+	__m512d y_d_1 = _mm512_sub_pd(y_d, one);
+	__m512d z_d_1 = _mm512_sub_pd(z_d, one);
+
+	// Interpolate between the corners, in the same order as libnoise.
+
+	__m512d x_s_1 = _mm512_sub_pd(one, x_s);
+	__m512d y_s_1 = _mm512_sub_pd(one, y_s);
+	__m512d z_s_1 = _mm512_sub_pd(one, z_s);
+
+	__m512d n_0;
+	__m512d n_1;
+
+	n_0 = get_gradient_dot_avx512(_mm256_add_epi32(_mm256_add_epi32(x_h_0, y_h_0), z_h_0), x_d, y_d, z_d, gradients);
+	n_1 = get_gradient_dot_avx512(_mm256_add_epi32(_mm256_add_epi32(x_h_1, y_h_0), z_h_0), x_d_1, y_d, z_d, gradients);
+
+	__m512d i_x_0 = _mm512_add_pd(_mm512_mul_pd(x_s_1, n_0), _mm512_mul_pd(x_s, n_1));
+
+	n_0 = get_gradient_dot_avx512(_mm256_add_epi32(_mm256_add_epi32(x_h_0, y_h_1), z_h_0), x_d, y_d_1, z_d, gradients);
+	n_1 = get_gradient_dot_avx512(_mm256_add_epi32(_mm256_add_epi32(x_h_1, y_h_1), z_h_0), x_d_1, y_d_1, z_d, gradients);
+
+	__m512d i_x_1 = _mm512_add_pd(_mm512_mul_pd(x_s_1, n_0), _mm512_mul_pd(x_s, n_1));
+
+	__m512d i_y_0 = _mm512_add_pd(_mm512_mul_pd(y_s_1, i_x_0), _mm512_mul_pd(y_s, i_x_1));
+
+	n_0 = get_gradient_dot_avx512(_mm256_add_epi32(_mm256_add_epi32(x_h_0, y_h_0), z_h_1), x_d, y_d, z_d_1, gradients);
+	n_1 = get_gradient_dot_avx512(_mm256_add_epi32(_mm256_add_epi32(x_h_1, y_h_0), z_h_1), x_d_1, y_d, z_d_1, gradients);
+
+	i_x_0 = _mm512_add_pd(_mm512_mul_pd(x_s_1, n_0), _mm512_mul_pd(x_s, n_1));
+
+	n_0 = get_gradient_dot_avx512(_mm256_add_epi32(_mm256_add_epi32(x_h_0, y_h_1), z_h_1), x_d, y_d_1, z_d_1, gradients);
+	n_1 = get_gradient_dot_avx512(_mm256_add_epi32(_mm256_add_epi32(x_h_1, y_h_1), z_h_1), x_d_1, y_d_1, z_d_1, gradients);
+
+	i_x_1 = _mm512_add_pd(_mm512_mul_pd(x_s_1, n_0), _mm512_mul_pd(x_s, n_1));
+
+	__m512d i_y_1 = _mm512_add_pd(_mm512_mul_pd(y_s_1, i_x_0), _mm512_mul_pd(y_s, i_x_1));
+
+	return _mm512_add_pd(_mm512_mul_pd(z_s_1, i_y_0), _mm512_mul_pd(z_s, i_y_1));
+}
+
+/*
+
+The same as get_perlin_values_avx2 and get_ridged_multi_values_avx2, 8 
+points at a time with AVX-512. count must be a multiple of 8.
+
+*/
+
+__attribute__((target("avx512f")))
+void get_perlin_values_avx512(const noise::module::Perlin& module, const double* x, const double* y, const double* z, double* values, size_t count)
+{
+	const double* gradients = get_gradient_vectors();
+
+	__m512d frequency = _mm512_set1_pd(module.GetFrequency());
+
+	__m512d lacunarity = _mm512_set1_pd(module.GetLacunarity());
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m512d p_x = _mm512_mul_pd(_mm512_loadu_pd(x + i), frequency);
+		__m512d p_y = _mm512_mul_pd(_mm512_loadu_pd(y + i), frequency);
+		__m512d p_z = _mm512_mul_pd(_mm512_loadu_pd(z + i), frequency);
+
+		__m512d value = _mm512_setzero_pd();
+
+		double persistence = 1.0;
+
+		for (int octave = 0; octave < module.GetOctaveCount(); octave++)
+		{
+			__m512d signal = get_gradient_coherent_noise_avx512(p_x, p_y, p_z, (module.GetSeed() + octave) & 0xFFFFFFFF, module.GetNoiseQuality(), gradients);
+
+			value = _mm512_add_pd(value, _mm512_mul_pd(signal, _mm512_set1_pd(persistence)));
+
+			p_x = _mm512_mul_pd(p_x, lacunarity);
+			p_y = _mm512_mul_pd(p_y, lacunarity);
+			p_z = _mm512_mul_pd(p_z, lacunarity);
+
+			persistence *= module.GetPersistence();
+		}
+
+		_mm512_storeu_pd(values + i, value);
+	}
+}
+
+__attribute__((target("avx512f")))
+void get_ridged_multi_values_avx512(const noise::module::RidgedMulti& module, const double* x, const double* y, const double* z, double* values, size_t count)
+{
+	const double* gradients = get_gradient_vectors();
+
+	std::array<double, 30> spectral_weights = get_ridged_multi_spectral_weights(module);
+
+	__m512d frequency = _mm512_set1_pd(module.GetFrequency());
+
+	__m512d lacunarity = _mm512_set1_pd(module.GetLacunarity());
+
+	__m512d zero = _mm512_setzero_pd();
+
+	__m512d one = _mm512_set1_pd(1.0);
+
+	__m512d two = _mm512_set1_pd(2.0);
+
+	for (size_t i = 0; i < count; i += 8)
+	{
+		__m512d p_x = _mm512_mul_pd(_mm512_loadu_pd(x + i), frequency);
+		__m512d p_y = _mm512_mul_pd(_mm512_loadu_pd(y + i), frequency);
+		__m512d p_z = _mm512_mul_pd(_mm512_loadu_pd(z + i), frequency);
+
+		__m512d value = _mm512_setzero_pd();
+
+		__m512d weight = one;
+
+		for (int octave = 0; octave < module.GetOctaveCount(); octave++)
+		{
+			__m512d signal = get_gradient_coherent_noise_avx512(p_x, p_y, p_z, (module.GetSeed() + octave) & 0x7FFFFFFF, module.GetNoiseQuality(), gradients);
+
+			// Make ridges, weight each octave by the one before it, and keep
+			// the weights between 0 and 1. The masked minimum and maximum 
+			// avoid the undefined vectors of the unmasked ones.
+
+			signal = _mm512_sub_pd(one, _mm512_abs_pd(signal));
+
+			signal = _mm512_mul_pd(_mm512_mul_pd(signal, signal), weight);
+
+			weight = _mm512_mask_max_pd(zero, 0xFF, _mm512_mask_min_pd(zero, 0xFF, _mm512_mul_pd(signal, two), one), zero);
+
+			value = _mm512_add_pd(value, _mm512_mul_pd(signal, _mm512_set1_pd(spectral_weights[octave])));
+
+			p_x = _mm512_mul_pd(p_x, lacunarity);
+			p_y = _mm512_mul_pd(p_y, lacunarity);
+			p_z = _mm512_mul_pd(p_z, lacunarity);
+		}
+
+		_mm512_storeu_pd(values + i, _mm512_sub_pd(_mm512_mul_pd(value, _mm512_set1_pd(1.25)), one));
+	}
+}
+
+#endif
+
+/*
+
+The ways that the batched noise functions below can evaluate noise modules.
+
+*/
+
+enum noise_kernel
+{
+	noise_kernel_scalar,
+	noise_kernel_avx2,
+	noise_kernel_avx512
+};
+
+/*
+
+Return the fastest noise_kernel that the CPU supports.
+
+*/
+
+noise_kernel get_noise_kernel()
+{
+#ifdef PLANET_NOISE_SIMD
+
+	static const noise_kernel kernel = __builtin_cpu_supports("avx512f") ? noise_kernel_avx512 : (__builtin_cpu_supports("avx2") ? noise_kernel_avx2 : noise_kernel_scalar);
+
+	return kernel;
+
+#else
+
+	return noise_kernel_scalar;
+
+#endif
+}
+
+/*
+
+Return whether the coordinates of count points stay below 2 ^ 29 at every 
+octave of a noise module, with some margin below the 2 ^ 30 at which 
+noise::MakeInt32Range starts to wrap them around, which the SIMD kernels do 
+not do.
+
+*/
+
+bool is_in_noise_range(const double* x, const double* y, const double* z, size_t count, double frequency, double lacunarity, int octave_count)
+{
+	double scale = std::fabs(frequency);
+
+	double max_scale = scale;
+
+	for (int i = 1; i < octave_count; i++)
+	{
+		scale *= std::fabs(lacunarity);
+
+		max_scale = std::max(max_scale, scale);
+	}
+
+	double max_coordinate = 0.0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		max_coordinate = std::max(max_coordinate, std::max(std::fabs(x[i]), std::max(std::fabs(y[i]), std::fabs(z[i]))));
+	}
+
+	return max_coordinate * max_scale < 536870912.0;
+}
+
+/*
+
+Run a SIMD kernel that evaluates width points at a time on count points. The
+last points are copied into a full batch, padded with the last point.
+
+*/
+
+template <typename kernel_function>
+void run_noise_kernel(size_t width, const double* x, const double* y, const double* z, double* values, size_t count, kernel_function kernel)
+{
+	size_t full_count = count - count % width;
+
+	if (full_count > 0)
+	{
+		kernel(x, y, z, values, full_count);
+	}
+
+	if (full_count < count)
+	{
+		double batch_x[8];
+		double batch_y[8];
+		double batch_z[8];
+
+		double batch_values[8];
+
+		for (size_t i = 0; i < width; i++)
+		{
+			size_t source = std::min(full_count + i, count - 1);
+
+			batch_x[i] = x[source];
+			batch_y[i] = y[source];
+			batch_z[i] = z[source];
+		}
+
+		kernel(batch_x, batch_y, batch_z, batch_values, width);
+
+		std::copy(batch_values, batch_values + (count - full_count), values + full_count);
+	}
+}
+
+/*
+
+Evaluate a Perlin module at count points, whose coordinates are stored in 
+separate arrays, with the fastest noise_kernel (unless a different one is 
+given). The results match Perlin::GetValue to within 1e-12, because the SIMD
+kernels scale the gradient vectors before the dot products rather than after
+them. Points that are too far from the origin for the SIMD kernels (see 
+is_in_noise_range) are evaluated with Perlin::GetValue.
+
+*/
+
+void get_perlin_values(const noise::module::Perlin& module, const double* x, const double* y, const double* z, double* values, size_t count, noise_kernel kernel = get_noise_kernel())
+{
+	if (kernel != noise_kernel_scalar && !is_in_noise_range(x, y, z, count, module.GetFrequency(), module.GetLacunarity(), module.GetOctaveCount()))
+	{
+		kernel = noise_kernel_scalar;
+	}
+
+#ifdef PLANET_NOISE_SIMD
+
+	if (kernel == noise_kernel_avx512)
+	{
+		run_noise_kernel(8, x, y, z, values, count, [&](const double* x, const double* y, const double* z, double* values, size_t count)
+		{
+			get_perlin_values_avx512(module, x, y, z, values, count);
+		});
+
+		return;
+	}
+	else if (kernel == noise_kernel_avx2)
+	{
+		run_noise_kernel(4, x, y, z, values, count, [&](const double* x, const double* y, const double* z, double* values, size_t count)
+		{
+			get_perlin_values_avx2(module, x, y, z, values, count);
+		});
+
+		return;
+	}
+
+#endif
+
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = module.GetValue(x[i], y[i], z[i]);
+	}
+}
+
+/*
+
+The same as get_perlin_values, for a RidgedMulti module.
+
+*/
+
+void get_ridged_multi_values(const noise::module::RidgedMulti& module, const double* x, const double* y, const double* z, double* values, size_t count, noise_kernel kernel = get_noise_kernel())
+{
+	if (kernel != noise_kernel_scalar && !is_in_noise_range(x, y, z, count, module.GetFrequency(), module.GetLacunarity(), module.GetOctaveCount()))
+	{
+		kernel = noise_kernel_scalar;
+	}
+
+#ifdef PLANET_NOISE_SIMD
+
+	if (kernel == noise_kernel_avx512)
+	{
+		run_noise_kernel(8, x, y, z, values, count, [&](const double* x, const double* y, const double* z, double* values, size_t count)
+		{
+			get_ridged_multi_values_avx512(module, x, y, z, values, count);
+		});
+
+		return;
+	}
+	else if (kernel == noise_kernel_avx2)
+	{
+		run_noise_kernel(4, x, y, z, values, count, [&](const double* x, const double* y, const double* z, double* values, size_t count)
+		{
+			get_ridged_multi_values_avx2(module, x, y, z, values, count);
+		});
+
+		return;
+	}
+
+#endif
+
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = module.GetValue(x[i], y[i], z[i]);
+	}
+}
+
+/*
+
+Evaluate any noise module at count points, whose coordinates are stored in 
+separate arrays. Perlin and RidgedMulti modules go through get_perlin_values
+and get_ridged_multi_values, and all other modules (including ones derived 
+from those two, which may override GetValue) call GetValue for each point.
+
+*/
+
+void get_module_values(const noise::module::Module& module, const double* x, const double* y, const double* z, double* values, size_t count)
+{
+	if (typeid(module) == typeid(noise::module::Perlin))
+	{
+		get_perlin_values(static_cast<const noise::module::Perlin&>(module), x, y, z, values, count);
+	}
+	else if (typeid(module) == typeid(noise::module::RidgedMulti))
+	{
+		get_ridged_multi_values(static_cast<const noise::module::RidgedMulti&>(module), x, y, z, values, count);
+	}
+	else
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			values[i] = module.GetValue(x[i], y[i], z[i]);
+		}
+	}
+}
+
+/*
+
+Return the noise value of the terrain at a point on the unit sphere. Negative
+values are below sea level.
+
+*/
+
+float get_terrain_noise(const noise::module::Perlin& noise_1, const noise::module::RidgedMulti& noise_2, glm::vec3 vertex)
+{
+	return noise_1.GetValue(vertex.x, vertex.y, vertex.z) * (noise_2.GetValue(vertex.x, vertex.y, vertex.z) + 0.2f);
+}
+
+/*
+
+Find the noise values of the terrain at count points on the unit sphere, the
+same way as get_terrain_noise. The points are copied into separate coordinate
+arrays and evaluated in blocks of 256, which fit in the L1 cache.
+
+*/
+
+void get_terrain_noise_values(const noise::module::Perlin& noise_1, const noise::module::RidgedMulti& noise_2, const glm::vec3* vertices, float* noise_values, size_t count)
+{
+	const size_t block_size = 256;
+
+	double x[block_size];
+	double y[block_size];
+	double z[block_size];
+
+	double values_1[block_size];
+	double values_2[block_size];
+
+	for (size_t first = 0; first < count; first += block_size)
+	{
+		size_t size = std::min(block_size, count - first);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			x[i] = vertices[first + i].x;
+			y[i] = vertices[first + i].y;
+			z[i] = vertices[first + i].z;
+		}
+
+		get_module_values(noise_1, x, y, z, values_1, size);
+		get_module_values(noise_2, x, y, z, values_2, size);
+
+		for (size_t i = 0; i < size; i++)
+		{
+			noise_values[first + i] = values_1[i] * (values_2[i] + 0.2f);
+		}
+	}
+}
+
+/*
+
+Return the position of a point on the unit sphere after it is perturbed by a
+noise value. The noise value is clamped to create smooth, flat water.
+
+*/
+
+glm::vec3 get_terrain_position(glm::vec3 vertex, float noise_value)
+{
+	return vertex * (1.0f + std::max(0.0f, noise_value) * 0.075f);
+}
+
+/*
+
+Generate a flat shaded icosphere with the given amount of subdivisions as a
+triangle soup, and pass it to a sink in batches of finished vertices (9 floats
+each: position, color and normal), so that it never has to be held in memory
+as a whole. The faces of the icosahedron are walked in order, and each face is
+cut into triangular patches of at most patch_segments segments per edge, which
+are generated in parallel, a few at a time. Every vertex of a patch is found 
+directly from its lattice coordinates, so no state is kept between patches, 
+and the memory used does not depend on the amount of subdivisions.
+
+Patches that share an edge compute the same positions for it, because 
+get_barycentric_position does not depend on which face or patch a point is 
+seen from, so the soup has no cracks. When skip_water is true, triangles that
+lie entirely at sea level are left out, for when the ocean is drawn 
+separately.
+
+*/
+
+void stream_icosphere
+(
+	int subdivisions,
+
+	const noise::module::Perlin& noise_1,
+	const noise::module::RidgedMulti& noise_2,
+	const noise::utils::GradientColor& color_map,
+
+	const std::function<void(const float*, size_t)>& sink,
+
+	bool skip_water = false,
+
+	int patch_segments = 64
+)
+{
+	int segments = 1 << subdivisions;
+
+	while (patch_segments > segments || segments % patch_segments != 0)
+	{
+		patch_segments /= 2;
+	}
+
+	// List the patches of a face. Patches with orientation 1 have their 
+	// corners at (i, j), (i + patch_segments, j) and (i, j + patch_segments),
+	// patches with orientation -1 are rotated by 180 degrees, which keeps 
+	// their winding.
+
+	int patches_per_edge = segments / patch_segments;
+
+	std::vector<std::tuple<int, int, int>> patches;
+
+	for (int b = 0; b < patches_per_edge; b++)
+	{
+		for (int a = 0; a + b < patches_per_edge; a++)
+		{
+			patches.push_back(std::make_tuple(a * patch_segments, b * patch_segments, 1));
+
+			if (a + b < patches_per_edge - 1)
+			{
+				patches.push_back(std::make_tuple((a + 1) * patch_segments, (b + 1) * patch_segments, -1));
+			}
+		}
+	}
+
+	std::vector<glm::vec3> icosahedron_vertices;
+
+	add_icosahedron_vertices(icosahedron_vertices);
+
+	// Allocate the batch, and the lattice of every patch in the batch.
+
+	size_t batch_patch_count = std::max(std::thread::hardware_concurrency(), 1u) * 2;
+
+	int row = patch_segments + 1;
+
+	size_t patch_float_count = size_t(patch_segments) * patch_segments * 3 * 9;
+
+	std::vector<float> batch(batch_patch_count * patch_float_count);
+
+	std::vector<glm::vec3> lattice_positions(batch_patch_count * row * row);
+
+	std::vector<float> lattice_noise(batch_patch_count * row * row);
+
+	// The amount of vertices written for every patch in the batch.
+
+	std::vector<size_t> patch_vertex_counts(batch_patch_count);
+
+	for (int face = 0; face < 20; face++)
+	{
+		glm::vec3 c_0 = icosahedron_vertices[icosahedron_faces[face][0]];
+		glm::vec3 c_1 = icosahedron_vertices[icosahedron_faces[face][1]];
+		glm::vec3 c_2 = icosahedron_vertices[icosahedron_faces[face][2]];
+
+		for (size_t first = 0; first < patches.size(); first += batch_patch_count)
+		{
+			size_t count = std::min(batch_patch_count, patches.size() - first);
+
+			get_thread_pool().parallel_for(count, 1, [&](size_t begin, size_t end)
+			{
+				for (size_t k = begin; k < end; k++)
+				{
+					int i = std::get<0>(patches[first + k]);
+					int j = std::get<1>(patches[first + k]);
+
+					int orientation = std::get<2>(patches[first + k]);
+
+					glm::vec3* positions = &lattice_positions[k * row * row];
+
+					float* noise_map = &lattice_noise[k * row * row];
+
+					// Perturb the patch's lattice. The points of each row are 
+					// found first, so that their noise values can be found in 
+					// one batch.
+
+					for (int v = 0; v <= patch_segments; v++)
+					{
+						int row_size = patch_segments - v + 1;
+
+						for (int u = 0; u < row_size; u++)
+						{
+							positions[v * row + u] = get_barycentric_position(c_0, c_1, c_2, segments, i + u * orientation, j + v * orientation);
+						}
+
+						get_terrain_noise_values(noise_1, noise_2, &positions[v * row], &noise_map[v * row], row_size);
+
+						for (int u = 0; u < row_size; u++)
+						{
+							positions[v * row + u] = get_terrain_position(positions[v * row + u], noise_map[v * row + u]);
+						}
+					}
+
+					// Write the patch's triangles, row by row.
+
+					float* vertices = &batch[k * patch_float_count];
+
+					for (int v = 0; v < patch_segments; v++)
+					{
+						for (int u = 0; u + v < patch_segments; u++)
+						{
+							for (int l = 0; l < 2; l++)
+							{
+								if (l == 1 && u + v + 1 == patch_segments)
+								{
+									continue;
+								}
+
+								int triangle[3] =
+								{
+									v * row + u + l,
+									(v + l) * row + u + 1,
+									(v + 1) * row + u
+								};
+
+								if (skip_water && noise_map[triangle[0]] <= 0.0f && noise_map[triangle[1]] <= 0.0f && noise_map[triangle[2]] <= 0.0f)
+								{
+									continue;
+								}
+
+								glm::vec3 normal = glm::normalize(glm::cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]));
+
+								for (int m = 0; m < 3; m++)
+								{
+									utils::Color color = color_map.GetColor(noise_map[triangle[m]]);
+
+									vertices[0] = positions[triangle[m]].x;
+									vertices[1] = positions[triangle[m]].y;
+									vertices[2] = positions[triangle[m]].z;
+
+									vertices[3] = color.red / 255.0f;
+									vertices[4] = color.green / 255.0f;
+									vertices[5] = color.blue / 255.0f;
+
+									vertices[6] = normal.x;
+									vertices[7] = normal.y;
+									vertices[8] = normal.z;
+
+									vertices += 9;
+								}
+							}
+						}
+					}
+
+					patch_vertex_counts[k] = (vertices - &batch[k * patch_float_count]) / 9;
+				}
+			});
+
+			// Move the patches' vertices together, unless no triangles were 
+			// skipped.
+
+			size_t batch_vertex_count = patch_vertex_counts[0];
+
+			for (size_t k = 1; k < count; k++)
+			{
+				if (batch_vertex_count * 9 != k * patch_float_count)
+				{
+					std::copy(&batch[k * patch_float_count], &batch[k * patch_float_count] + patch_vertex_counts[k] * 9, &batch[batch_vertex_count * 9]);
+				}
+
+				batch_vertex_count += patch_vertex_counts[k];
+			}
+
+			if (batch_vertex_count > 0)
+			{
+				sink(&batch[0], batch_vertex_count);
+			}
+		}
+	}
+}
+
+/*
+
+Create an icosphere whose triangles are only subdivided where the terrain 
+needs them, and find the noise value of each of its vertices. Starting from 
+the icosahedron, a triangle is split into 4 (like subdivide_icosphere does) 
+when the perturbed terrain at the midpoint of any of its edges is further 
+than tolerance from the midpoint of the perturbed edge itself, until 
+max_subdivisions is reached. Triangles are always split min_subdivisions 
+times, so that small islands are not missed. Flat water stops being split 
+once the triangles are small enough to follow the curvature of the sphere.
+
+Triangles that share an edge then differ by at most one subdivision (more 
+triangles are split until that is the case), so a triangle is replaced by 2,
+3 or 4 triangles through the midpoints that its finer neighbors use, and the
+mesh has no cracks. All vertices lie on the lattice of an icosphere with 
+max_subdivisions subdivisions, and are found by their index from 
+get_lattice_vertex, so vertices on the edges of the icosahedron are shared 
+between its faces. The triangles of each face of the icosahedron are stored
+contiguously.
+
+*/
+
+indexed_mesh create_icosphere_adaptive
+(
+	int max_subdivisions,
+
+	const noise::module::Perlin& noise_1,
+	const noise::module::RidgedMulti& noise_2,
+
+	std::vector<float>& noise_map,
+
+	float tolerance = 0.0002f,
+
+	int min_subdivisions = 4
+)
+{
+	int n = 1 << max_subdivisions;
+
+	icosahedron_edges edges = create_icosahedron_edges();
+
+	std::vector<glm::vec3> icosahedron_vertices;
+
+	add_icosahedron_vertices(icosahedron_vertices);
+
+	// The vertices that have been created so far, on the unit sphere, and 
+	// the index of the vertex at every point of the lattice, or -1. Vertices
+	// are created for the midpoints of every triangle that might be split, 
+	// and only the ones that are used end up in the mesh.
+
+	std::vector<glm::vec3> vertices;
+
+	std::vector<int> lattice_vertices(size_t(10) * n * n + 2, -1);
+
+	auto find_vertex = [&](int face, int i, int j)
+	{
+		return lattice_vertices[get_lattice_vertex(edges, n, face, i, j)];
+	};
+
+	auto add_vertex = [&](int face, int i, int j)
+	{
+		int& vertex = lattice_vertices[get_lattice_vertex(edges, n, face, i, j)];
+
+		if (vertex < 0)
+		{
+			const int* corners = icosahedron_faces[face];
+
+			vertex = vertices.size();
+
+			vertices.push_back(get_barycentric_position(icosahedron_vertices[corners[0]], icosahedron_vertices[corners[1]], icosahedron_vertices[corners[2]], n, i, j));
+		}
+
+		return vertex;
+	};
+
+	// Find the noise values of the vertices that do not have one yet, in 
+	// parallel.
+
+	auto add_noise_values = [&]()
+	{
+		size_t first = noise_map.size();
+
+		noise_map.resize(vertices.size());
+
+		get_thread_pool().parallel_for(vertices.size() - first, 256, [&](size_t begin, size_t end)
+		{
+			get_terrain_noise_values(noise_1, noise_2, &vertices[first + begin], &noise_map[first + begin], end - begin);
+		});
+	};
+
+	// A triangle has its corners at (i, j), (i + size, j) and (i, j + size) 
+	// on the lattice of its face when its orientation is 1, and is rotated by
+	// 180 degrees when its orientation is -1. Its edges run from corner l to
+	// corner l + 1, and midpoint l is the midpoint of edge l.
+
+	struct lattice_triangle
+	{
+		int face;
+
+		int i;
+		int j;
+
+		int size;
+
+		int orientation;
+	};
+
+	auto get_corners = [&](const lattice_triangle& t, int corners[3])
+	{
+		int s = t.size * t.orientation;
+
+		corners[0] = find_vertex(t.face, t.i, t.j);
+		corners[1] = find_vertex(t.face, t.i + s, t.j);
+		corners[2] = find_vertex(t.face, t.i, t.j + s);
+	};
+
+	auto get_midpoints = [&](const lattice_triangle& t, int midpoints[3], bool create)
+	{
+		int h = t.size / 2 * t.orientation;
+
+		if (create)
+		{
+			midpoints[0] = add_vertex(t.face, t.i + h, t.j);
+			midpoints[1] = add_vertex(t.face, t.i + h, t.j + h);
+			midpoints[2] = add_vertex(t.face, t.i, t.j + h);
+		}
+		else
+		{
+			midpoints[0] = find_vertex(t.face, t.i + h, t.j);
+			midpoints[1] = find_vertex(t.face, t.i + h, t.j + h);
+			midpoints[2] = find_vertex(t.face, t.i, t.j + h);
+		}
+	};
+
+	auto split_triangle = [](const lattice_triangle& t, std::vector<lattice_triangle>& children)
+	{
+		int h = t.size / 2;
+
+		int s = h * t.orientation;
+
+		lattice_triangle corner_0 = {t.face, t.i, t.j, h, t.orientation};
+		lattice_triangle corner_1 = {t.face, t.i + s, t.j, h, t.orientation};
+		lattice_triangle corner_2 = {t.face, t.i, t.j + s, h, t.orientation};
+		lattice_triangle middle = {t.face, t.i + s, t.j + s, h, -t.orientation};
+
+		children.push_back(corner_0);
+		children.push_back(corner_1);
+		children.push_back(corner_2);
+		children.push_back(middle);
+	};
+
+	// Split the faces of the icosahedron level by level. The midpoints of 
+	// all triangles of a level get their noise values at once, and then each
+	// triangle is either split or kept as a leaf.
+
+	std::vector<lattice_triangle> triangles;
+
+	std::vector<lattice_triangle> next_triangles;
+
+	std::vector<lattice_triangle> leaves;
+
+	for (int face = 0; face < 20; face++)
+	{
+		lattice_triangle root = {face, 0, 0, n, 1};
+
+		triangles.push_back(root);
+
+		add_vertex(face, 0, 0);
+		add_vertex(face, n, 0);
+		add_vertex(face, 0, n);
+	}
+
+	for (int level = 0; !triangles.empty(); level++)
+	{
+		std::vector<int> triangle_midpoints;
+
+		for (size_t k = 0; k < triangles.size(); k++)
+		{
+			if (triangles[k].size > 1)
+			{
+				int midpoints[3];
+
+				get_midpoints(triangles[k], midpoints, true);
+
+				triangle_midpoints.insert(triangle_midpoints.end(), midpoints, midpoints + 3);
+			}
+		}
+
+		add_noise_values();
+
+		next_triangles.clear();
+
+		size_t m = 0;
+
+		for (size_t k = 0; k < triangles.size(); k++)
+		{
+			const lattice_triangle& t = triangles[k];
+
+			if (t.size == 1)
+			{
+				leaves.push_back(t);
+
+				continue;
+			}
+
+			bool split = level < min_subdivisions;
+
+			if (!split)
+			{
+				int corners[3];
+
+				get_corners(t, corners);
+
+				for (int l = 0; l < 3 && !split; l++)
+				{
+					int p_1 = corners[l];
+					int p_2 = corners[(l + 1) % 3];
+
+					int midpoint = triangle_midpoints[m + l];
+
+					glm::vec3 edge_midpoint = (get_terrain_position(vertices[p_1], noise_map[p_1]) + get_terrain_position(vertices[p_2], noise_map[p_2])) * 0.5f;
+
+					split = glm::length(get_terrain_position(vertices[midpoint], noise_map[midpoint]) - edge_midpoint) > tolerance;
+				}
+			}
+
+			m += 3;
+
+			if (split)
+			{
+				split_triangle(t, next_triangles);
+			}
+			else
+			{
+				leaves.push_back(t);
+			}
+		}
+
+		triangles.swap(next_triangles);
+	}
+
+	// Mark the vertices that are corners of leaves as used.
+
+	std::vector<char> used(vertices.size(), 0);
+
+	for (size_t k = 0; k < leaves.size(); k++)
+	{
+		int corners[3];
+
+		get_corners(leaves[k], corners);
+
+		for (int l = 0; l < 3; l++)
+		{
+			used[corners[l]] = 1;
+		}
+	}
+
+	// Split the leaves that have a neighbor at least two subdivisions finer,
+	// which is the case when a quarter point of one of their edges is used 
+	// by the neighbor. Splitting a leaf can require its neighbors to be 
+	// split too, so this is repeated until no leaf is split.
+
+	auto is_used = [&](int face, int i, int j)
+	{
+		int vertex = find_vertex(face, i, j);
+
+		return vertex >= 0 && used[vertex];
+	};
+
+	bool balanced = false;
+
+	while (!balanced)
+	{
+		balanced = true;
+
+		next_triangles.clear();
+
+		for (size_t k = 0; k < leaves.size(); k++)
+		{
+			const lattice_triangle& t = leaves[k];
+
+			bool split = false;
+
+			if (t.size >= 4)
+			{
+				int q = t.size * t.orientation / 4;
+
+				split =
+				(
+					is_used(t.face, t.i + q, t.j) ||
+					is_used(t.face, t.i + q * 3, t.j) ||
+					is_used(t.face, t.i + q * 3, t.j + q) ||
+					is_used(t.face, t.i + q, t.j + q * 3) ||
+					is_used(t.face, t.i, t.j + q * 3) ||
+					is_used(t.face, t.i, t.j + q)
+				);
+			}
+
+			if (split)
+			{
+				int midpoints[3];
+
+				get_midpoints(t, midpoints, true);
+
+				used.resize(vertices.size(), 0);
+
+				for (int l = 0; l < 3; l++)
+				{
+					used[midpoints[l]] = 1;
+				}
+
+				split_triangle(t, next_triangles);
+
+				balanced = false;
+			}
+			else
+			{
+				next_triangles.push_back(t);
+			}
+		}
+
+		leaves.swap(next_triangles);
+	}
+
+	add_noise_values();
+
+	// Give the used vertices their final indices, in the order they were 
+	// created.
+
+	indexed_mesh mesh;
+
+	std::vector<int> mesh_vertices(vertices.size(), -1);
+
+	std::vector<float> mesh_noise_map;
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		if (used[i])
+		{
+			mesh_vertices[i] = mesh.vertices.size();
+
+			mesh.vertices.push_back(vertices[i]);
+
+			mesh_noise_map.push_back(noise_map[i]);
+		}
+	}
+
+	noise_map.swap(mesh_noise_map);
+
+	// Write the triangles of each leaf face by face. A leaf is split through
+	// the midpoints of its edges that are used by its neighbors, in the same
+	// winding as the leaf.
+
+	std::stable_sort(leaves.begin(), leaves.end(), [](const lattice_triangle& a, const lattice_triangle& b)
+	{
+		return a.face < b.face;
+	});
+
+	for (size_t k = 0; k < leaves.size(); k++)
+	{
+		const lattice_triangle& t = leaves[k];
+
+		int corners[3];
+
+		get_corners(t, corners);
+
+		for (int l = 0; l < 3; l++)
+		{
+			corners[l] = mesh_vertices[corners[l]];
+		}
+
+		int midpoints[3] = {-1, -1, -1};
+
+		int split_edges = 0;
+
+		if (t.size > 1)
+		{
+			get_midpoints(t, midpoints, false);
+
+			for (int l = 0; l < 3; l++)
+			{
+				if (midpoints[l] >= 0 && used[midpoints[l]])
+				{
+					midpoints[l] = mesh_vertices[midpoints[l]];
+
+					split_edges++;
+				}
+				else
+				{
+					midpoints[l] = -1;
+				}
+			}
+		}
+
+		auto add_triangle = [&](int p_1, int p_2, int p_3)
+		{
+			mesh.indices.push_back(p_1);
+			mesh.indices.push_back(p_2);
+			mesh.indices.push_back(p_3);
+		};
+
+		if (split_edges == 0)
+		{
+			add_triangle(corners[0], corners[1], corners[2]);
+		}
+		else if (split_edges == 3)
+		{
+			add_triangle(corners[0], midpoints[0], midpoints[2]);
+			add_triangle(midpoints[0], corners[1], midpoints[1]);
+			add_triangle(midpoints[2], midpoints[1], corners[2]);
+			add_triangle(midpoints[0], midpoints[1], midpoints[2]);
+		}
+		else
+		{
+			// Rotate the leaf so that edge l (from corner l to corner l + 1)
+			// is split, and edge l + 1 is the other split edge, if any.
+
+			int l = 0;
+
+			while (midpoints[l] < 0 || (split_edges == 2 && midpoints[(l + 1) % 3] < 0))
+			{
+				l++;
+			}
+
+			int p_0 = corners[l];
+			int p_1 = corners[(l + 1) % 3];
+			int p_2 = corners[(l + 2) % 3];
+
+			if (split_edges == 1)
+			{
+				add_triangle(p_0, midpoints[l], p_2);
+				add_triangle(midpoints[l], p_1, p_2);
+			}
+			else
+			{
+				int m_0 = midpoints[l];
+				int m_1 = midpoints[(l + 1) % 3];
+
+				add_triangle(m_0, p_1, m_1);
+				add_triangle(p_0, m_0, m_1);
+				add_triangle(p_0, m_1, p_2);
+			}
+		}
+	}
+
+	return mesh;
+}
+
+/*
+
+Return the colors of the ocean as an equirectangular RGB image of width x 
+height pixels, for ocean_fragment.glsl. The pixel (x, y) shows the direction
+at longitude atan2(z, x) = (x + 0.5) / width * 360 - 180 degrees and latitude
+asin(y) = (y + 0.5) / height * 180 - 90 degrees. Under land the ocean gets the
+color of sea level, so that the colors blend into the coast.
+
+*/
+
+std::vector<uint8_t> create_ocean_colors
+(
+	const noise::module::Perlin& noise_1,
+	const noise::module::RidgedMulti& noise_2,
+	const noise::utils::GradientColor& color_map,
+
+	int width = 512,
+	int height = 256
+)
+{
+	std::vector<uint8_t> colors(size_t(width) * height * 3);
+
+	get_thread_pool().parallel_for(height, 8, [&](size_t begin, size_t end)
+	{
+		for (size_t y = begin; y < end; y++)
+		{
+			float latitude = glm::radians((y + 0.5f) / height * 180.0f - 90.0f);
+
+			for (int x = 0; x < width; x++)
+			{
+				float longitude = glm::radians((x + 0.5f) / width * 360.0f - 180.0f);
+
+				glm::vec3 direction = glm::vec3(std::cos(latitude) * std::cos(longitude), std::sin(latitude), std::cos(latitude) * std::sin(longitude));
+
+				utils::Color color = color_map.GetColor(std::min(get_terrain_noise(noise_1, noise_2, direction), 0.0f));
+
+				uint8_t* pixel = &colors[(y * width + x) * 3];
+
+				pixel[0] = color.red;
+				pixel[1] = color.green;
+				pixel[2] = color.blue;
+			}
+		}
+	});
+
+	return colors;
+}
+
+/*
+
+Return whether a triangle on the unit sphere, and the terrain above it, is 
+hidden behind the horizon as seen from a camera. The terrain must be at most
+max_radius away from the center of the planet.
+
+*/
+
+bool is_behind_horizon(glm::vec3 camera_position, glm::vec3 c_0, glm::vec3 c_1, glm::vec3 c_2, float max_radius)
+{
+	glm::vec3 center = glm::normalize(c_0 + c_1 + c_2);
+
+	// A point at height h can be seen over the unit sphere from a camera at 
+	// distance d if the angle between them (seen from the center of the 
+	// planet) is less than acos(1 / d) + acos(1 / h).
+
+	float camera_distance = glm::length(camera_position);
+
+	float triangle_angle = std::acos(std::min(std::min(glm::dot(center, c_0), glm::dot(center, c_1)), glm::dot(center, c_2)));
+
+	float camera_angle = std::acos(std::max(std::min(glm::dot(center, camera_position / camera_distance), 1.0f), -1.0f));
+
+	return camera_distance > 1.0f && camera_angle - triangle_angle > std::acos(1.0f / camera_distance) + std::acos(1.0f / std::max(max_radius, 1.0f));
+}
+
+/*
+
+A view_frustum holds the 6 planes of a view frustum, as (a, b, c, d) so that 
+points p inside the frustum have a * p.x + b * p.y + c * p.z + d >= 0. The 
+normals (a, b, c) have unit length.
+
+*/
+
+struct view_frustum
+{
+	glm::vec4 planes[6];
+};
+
+/*
+
+Extract the view frustum of a matrix that transforms points into clip space,
+using the method of Gribb and Hartmann. The frustum is in the space that the
+matrix transforms from, so the frustum of matrix_projection * matrix_view * 
+matrix_model is in the planet's model space.
+
+*/
+
+view_frustum get_view_frustum(const glm::mat4& matrix)
+{
+	glm::vec4 rows[4];
+
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+	}
+
+	view_frustum frustum;
+
+	for (int i = 0; i < 3; i++)
+	{
+		frustum.planes[i * 2 + 0] = rows[3] + rows[i];
+		frustum.planes[i * 2 + 1] = rows[3] - rows[i];
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		glm::vec4& plane = frustum.planes[i];
+
+		plane = plane * (1.0f / glm::length(glm::vec3(plane.x, plane.y, plane.z)));
+	}
+
+	return frustum;
+}
+
+/*
+
+Return whether a sphere is completely outside of a view frustum.
+
+*/
+
+bool is_outside_frustum(const view_frustum& frustum, glm::vec3 center, float radius)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const glm::vec4& plane = frustum.planes[i];
+
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+
+A cube-sphere is a cube whose 6 faces are regular grids of segments x segments
+quads, projected onto the unit sphere. Unlike the icosphere, every face has a 
+natural 2D parameterisation, so the heights of a face, or of any rectangular 
+tile of it, can be stored as a row-major noise::utils::NoiseMap.
+
+Face f lies on the axis f / 2, on its positive side when f is even. The grid's
+x axis runs along the next axis (flipped on the negative faces, to keep the 
+triangles counter-clockwise from the outside) and its y axis along the one 
+after that.
+
+*/
+
+glm::vec3 get_cube_sphere_point(int face, int segments, int x, int y)
+{
+	int axis = face / 2;
+
+	float sign = face % 2 == 0 ? 1.0f : -1.0f;
+
+	// The grid coordinates are computed so that the coordinates of opposite
+	// grid points are exact negations of each other. Grid points on the edge
+	// of two faces then get bitwise identical positions from either face. 
+	// Adding 0 turns -0 into 0.
+
+	glm::vec3 cube;
+
+	cube[axis] = sign;
+
+	cube[(axis + 1) % 3] = sign * (float(2 * x - segments) / float(segments)) + 0.0f;
+	cube[(axis + 2) % 3] = float(2 * y - segments) / float(segments) + 0.0f;
+
+	// Spread the grid points evenly over the sphere. Each component is 
+	// computed from the other two in a fixed order, so the result only 
+	// depends on the point on the cube.
+
+	glm::vec3 squared = cube * cube;
+
+	glm::vec3 sphere;
+
+	sphere.x = cube.x * std::sqrt(1.0f - squared.y * 0.5f - squared.z * 0.5f + squared.y * squared.z / 3.0f);
+	sphere.y = cube.y * std::sqrt(1.0f - squared.z * 0.5f - squared.x * 0.5f + squared.z * squared.x / 3.0f);
+	sphere.z = cube.z * std::sqrt(1.0f - squared.x * 0.5f - squared.y * 0.5f + squared.x * squared.y / 3.0f);
+
+	return glm::normalize(sphere);
+}
+
+/*
+
+A cube_sphere_mesh is a cube-sphere as an indexed mesh, whose grid points on 
+the edges and corners of the faces are shared by the faces that meet there.
+grid_vertices maps every grid point (face, x, y) to its vertex, at index 
+(face * (segments + 1) + y) * (segments + 1) + x. The triangles of each face 
+are contiguous.
+
+*/
+
+struct cube_sphere_mesh
+{
+	int segments;
+
+	indexed_mesh mesh;
+
+	std::vector<unsigned int> grid_vertices;
+};
+
+/*
+
+Create a cube-sphere with segments x segments quads per face.
+
+*/
+
+cube_sphere_mesh create_cube_sphere(int segments)
+{
+	cube_sphere_mesh result;
+
+	result.segments = segments;
+
+	int row = segments + 1;
+
+	result.grid_vertices.resize(6 * row * row);
+
+	// Add the vertices. Grid points on the border of a face are looked up by
+	// their position, so that each one is only added once.
+
+	std::map<std::tuple<uint32_t, uint32_t, uint32_t>, unsigned int> border_vertices;
+
+	for (int face = 0; face < 6; face++)
+	{
+		for (int y = 0; y <= segments; y++)
+		{
+			for (int x = 0; x <= segments; x++)
+			{
+				glm::vec3 position = get_cube_sphere_point(face, segments, x, y);
+
+				unsigned int& vertex = result.grid_vertices[(face * row + y) * row + x];
+
+				vertex = result.mesh.vertices.size();
+
+				if (x == 0 || y == 0 || x == segments || y == segments)
+				{
+					uint32_t bits[3];
+
+					for (int i = 0; i < 3; i++)
+					{
+						float component = position[i] + 0.0f;
+
+						memcpy(&bits[i], &component, sizeof(float));
+					}
+
+					std::tuple<uint32_t, uint32_t, uint32_t> key = std::make_tuple(bits[0], bits[1], bits[2]);
+
+					std::pair<std::map<std::tuple<uint32_t, uint32_t, uint32_t>, unsigned int>::iterator, bool> inserted = border_vertices.insert(std::make_pair(key, vertex));
+
+					if (!inserted.second)
+					{
+						vertex = inserted.first->second;
+
+						continue;
+					}
+				}
+
+				result.mesh.vertices.push_back(position);
+			}
+		}
+	}
+
+	// Split every quad into two triangles, alternating the diagonal in a 
+	// checkerboard pattern so that the grid has no preferred direction.
+
+	result.mesh.indices.reserve(6 * segments * segments * 6);
+
+	for (int face = 0; face < 6; face++)
+	{
+		const unsigned int* grid = &result.grid_vertices[face * row * row];
+
+		for (int y = 0; y < segments; y++)
+		{
+			for (int x = 0; x < segments; x++)
+			{
+				unsigned int v_00 = grid[y * row + x];
+				unsigned int v_10 = grid[y * row + x + 1];
+				unsigned int v_01 = grid[(y + 1) * row + x];
+				unsigned int v_11 = grid[(y + 1) * row + x + 1];
+
+				unsigned int quad[6] = {v_00, v_10, v_11, v_00, v_11, v_01};
+
+				if ((x + y) % 2 == 1)
+				{
+					unsigned int other_quad[6] = {v_00, v_10, v_01, v_10, v_11, v_01};
+
+					std::copy(other_quad, other_quad + 6, quad);
+				}
+
+				result.mesh.indices.insert(result.mesh.indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	return result;
+}
+
+/*
+
+Fill a NoiseMap with the terrain noise of a rectangular tile of a face of a 
+cube-sphere. The tile starts at grid point (x_0, y_0) and is width x height 
+grid points large, so tiles that should share their border must overlap by 
+one grid point. Rows are filled in parallel.
+
+*/
+
+void build_cube_sphere_noise_map(noise::utils::NoiseMap& noise_map, const noise::module::Perlin& noise_1, const noise::module::RidgedMulti& noise_2, int face, int segments, int x_0, int y_0, int width, int height)
+{
+	noise_map.SetSize(width, height);
+
+	get_thread_pool().parallel_for(height, 8, [&](size_t begin, size_t end)
+	{
+		std::vector<glm::vec3> points(width);
+
+		for (size_t y = begin; y < end; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				points[x] = get_cube_sphere_point(face, segments, x_0 + x, y_0 + y);
+			}
+
+			get_terrain_noise_values(noise_1, noise_2, &points[0], noise_map.GetSlabPtr(y), width);
+		}
+	});
+}
+
+/*
+
+A planet_lod draws the planet as a set of patches whose level of detail 
+follows the camera. Each face of the icosahedron is the root of a triangle 
+quadtree. A patch at depth d covers a triangle of the face's lattice with
+patch_segments << d segments per edge, and is itself a grid with 
+patch_segments segments per edge. Every frame, patches whose projected vertex 
+spacing exceeds a threshold in pixels are replaced by their 4 children, once 
+the children have been generated.
+
+Generated patches are kept in fixed-size slots of one vertex buffer and drawn 
+with one shared element buffer, so a patch is drawn with a single call to
+glDrawElementsBaseVertex. When every slot is in use, the patch that was least
+recently drawn is evicted.
+
+Patches are split at a distance proportional to their size, so neighbouring
+patches differ by at most one depth (as long as their children have been 
+generated). The element buffer holds one triangulation per combination of 
+edges that border a shallower patch, in which the vertices on those edges 
+that the shallower patch lacks are skipped. Every vertex also stores the 
+height of its patch's parent at the same point, and default_vertex.glsl 
+morphs vertices towards it as the patch gets close to being merged, so that 
+patches do not pop when they are split or merged.
+
+When the ocean is drawn separately (skip_submerged), patches that lie 
+entirely at sea level are not drawn.
+
+*/
+
+class planet_lod
+{
+public:
+
+	planet_lod
+	(
+		const noise::module::Perlin& noise_1,
+		const noise::module::RidgedMulti& noise_2,
+		const noise::utils::GradientColor& color_map,
+
+		bool skip_submerged = false,
+
+		int patch_segments = 16,
+
+		int max_depth = 12,
+
+		unsigned int slot_count = 8192
+	)
+	{
+		this->noise_1 = &noise_1;
+		this->noise_2 = &noise_2;
+
+		this->color_map = &color_map;
+
+		this->skip_submerged = skip_submerged;
+
+		this->patch_segments = patch_segments;
+
+		this->max_depth = max_depth;
+
+		max_radii.resize(max_depth + 1, 0.0f);
+
+		add_icosahedron_vertices(icosahedron_vertices);
+
+		edges = create_icosahedron_edges();
+
+		icosahedron_edge_length = glm::length(icosahedron_vertices[icosahedron_faces[0][0]] - icosahedron_vertices[icosahedron_faces[0][1]]);
+
+		patch_vertex_count = (patch_segments + 1) * (patch_segments + 2) / 2;
+
+		frame = 0;
+
+		drawn_triangle_count = 0;
+
+		frustum_culled_patch_count = 0;
+
+		horizon_culled_patch_count = 0;
+
+		submerged_patch_count = 0;
+
+		// Create the slots. All of them start out free.
+
+		slots.resize(slot_count);
+
+		for (unsigned int i = 0; i < slot_count; i++)
+		{
+			slots[i].key = 0;
+
+			slots[i].last_used = 0;
+
+			slots[i].used = false;
+		}
+
+		// Triangulate a patch once for every combination of stitched edges.
+
+		std::vector<unsigned short> indices;
+
+		for (int i = 0; i < 8; i++)
+		{
+			stitch_index_offsets[i] = indices.size() * sizeof(unsigned short);
+
+			add_patch_indices(indices, i);
+
+			stitch_index_counts[i] = indices.size() - stitch_index_offsets[i] / sizeof(unsigned short);
+		}
+
+		// Create the VAO, the VBO and the EBO. The VBO is allocated for every
+		// slot up front.
+
+		glGenVertexArrays(1, &vao);
+
+		glGenBuffers(1, &vbo);
+		glGenBuffers(1, &ebo);
+
+		glBindVertexArray(vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+		glBufferData(GL_ARRAY_BUFFER, slot_count * patch_vertex_count * (10 * sizeof(float)), NULL, GL_DYNAMIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
+
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(0 * sizeof(float)));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(3 * sizeof(float)));
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(6 * sizeof(float)));
+		glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(9 * sizeof(float)));
+
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+		glEnableVertexAttribArray(3);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glBindVertexArray(0);
+
+		// Generate the roots of the quadtrees. They are never evicted, so 
+		// there is always something to draw.
+
+		std::vector<uint64_t> roots;
+
+		for (int i = 0; i < 20; i++)
+		{
+			roots.push_back(get_patch_key(i, 0, 0, 0, 1));
+		}
+
+		generate_patches(roots);
+	}
+
+	~planet_lod()
+	{
+		glDeleteVertexArrays(1, &vao);
+
+		glDeleteBuffers(1, &vbo);
+		glDeleteBuffers(1, &ebo);
+	}
+
+	// Choose the patches to draw for a camera, and generate up to 
+	// generate_limit missing patches that would add detail. camera_position 
+	// and frustum are in model space, pixel_scale is the viewport's height in
+	// pixels divided by 2 * tan(fov / 2), and threshold is the largest 
+	// allowed vertex spacing in pixels.
+
+	void update(glm::vec3 camera_position, const view_frustum& frustum, float pixel_scale, float threshold, size_t generate_limit = 16)
+	{
+		frame++;
+
+		this->camera_position = camera_position;
+
+		this->pixel_scale = pixel_scale;
+
+		this->threshold = threshold;
+
+		drawn_patches.clear();
+
+		requests.clear();
+
+		for (int i = 0; i < 20; i++)
+		{
+			select_patch(i, 0, 0, 0, 1, 0.0f);
+		}
+
+		stitch_patches();
+
+		cull_patches(frustum);
+
+		// Generate the missing patches with the largest error first. They are
+		// drawn from the next frame on.
+
+		std::sort(requests.begin(), requests.end(), [](const std::pair<float, uint64_t>& a, const std::pair<float, uint64_t>& b)
+		{
+			return a.first > b.first;
+		});
+
+		std::vector<uint64_t> keys;
+
+		for (size_t i = 0; i < requests.size() && i < generate_limit; i++)
+		{
+			keys.push_back(requests[i].second);
+		}
+
+		generate_patches(keys);
+
+		drawn_triangle_count = 0;
+
+		for (size_t i = 0; i < drawn_patches.size(); i++)
+		{
+			drawn_triangle_count += stitch_index_counts[drawn_patches[i].stitched_edges] / 3;
+		}
+	}
+
+	// Draw the patches that were chosen by the last call to update, using a
+	// shader program with a morph_range uniform.
+
+	void draw(GLuint shader_program) const
+	{
+		GLint morph_range_location = glGetUniformLocation(shader_program, "morph_range");
+
+		glBindVertexArray(vao);
+
+		for (size_t i = 0; i < drawn_patches.size(); i++)
+		{
+			const patch_draw& patch = drawn_patches[i];
+
+			glUniform2f(morph_range_location, patch.morph_start, patch.morph_end);
+
+			glDrawElementsBaseVertex(GL_TRIANGLES, stitch_index_counts[patch.stitched_edges], GL_UNSIGNED_SHORT, (void*)stitch_index_offsets[patch.stitched_edges], patch.slot * patch_vertex_count);
+		}
+
+		glUniform2f(morph_range_location, 0.0f, 0.0f);
+
+		glBindVertexArray(0);
+	}
+
+	// Return the amount of patches and triangles drawn by draw.
+
+	size_t get_drawn_patch_count() const
+	{
+		return drawn_patches.size();
+	}
+
+	size_t get_drawn_triangle_count() const
+	{
+		return drawn_triangle_count;
+	}
+
+	// Return the amount of patches that were chosen by the last call to 
+	// update, but are not drawn because they are outside of the view frustum
+	// or behind the horizon.
+
+	size_t get_frustum_culled_patch_count() const
+	{
+		return frustum_culled_patch_count;
+	}
+
+	size_t get_horizon_culled_patch_count() const
+	{
+		return horizon_culled_patch_count;
+	}
+
+	// Return the amount of patches that were chosen by the last call to 
+	// update, but are not drawn because they lie entirely at sea level and
+	// skip_submerged is true.
+
+	size_t get_submerged_patch_count() const
+	{
+		return submerged_patch_count;
+	}
+
+	// Return the amount of patches that are stored in the vertex buffer.
+
+	size_t get_resident_patch_count() const
+	{
+		return patch_slots.size();
+	}
+
+private:
+
+	// A slot of the vertex buffer.
+
+	struct patch_slot
+	{
+		// The key of the patch in the slot.
+
+		uint64_t key;
+
+		// The last frame that the patch was used in.
+
+		unsigned int last_used;
+
+		bool used;
+
+		// A bounding sphere of the patch's vertices.
+
+		glm::vec3 center;
+
+		float radius;
+
+		// The largest distance of the patch's vertices from the center of the
+		// planet.
+
+		float max_radius;
+
+		// Whether none of the patch's vertices are above sea level.
+
+		bool submerged;
+	};
+
+	// A patch that is drawn by draw.
+
+	struct patch_draw
+	{
+		// The patch's key and slot.
+
+		uint64_t key;
+
+		unsigned int slot;
+
+		// A bit for each edge of the patch that borders a shallower patch. 
+		// The edges run from the first corner to the second, from the second
+		// to the third, and from the third to the first.
+
+		int stitched_edges;
+
+		// The distances from the camera at which vertices start and finish 
+		// morphing towards the patch's parent.
+
+		float morph_start;
+		float morph_end;
+	};
+
+	// Pack the address of a patch into a key. A patch is identified by the 
+	// face of the icosahedron that it lies on, its depth, the lattice 
+	// coordinates (i, j) of its first corner at its depth and its 
+	// orientation. Patches with orientation 1 have their other corners at
+	// (i + patch_segments, j) and (i, j + patch_segments), patches with
+	// orientation -1 are rotated by 180 degrees.
+
+	static uint64_t get_patch_key(int face, int depth, int i, int j, int orientation)
+	{
+		return (uint64_t(face) << 58) | (uint64_t(depth) << 53) | (uint64_t(orientation < 0) << 52) | (uint64_t(i) << 26) | uint64_t(j);
+	}
+
+	static void get_patch_address(uint64_t key, int& face, int& depth, int& i, int& j, int& orientation)
+	{
+		face = key >> 58;
+
+		depth = (key >> 53) & 31;
+
+		orientation = (key >> 52) & 1 ? -1 : 1;
+
+		i = (key >> 26) & 0x3FFFFFF;
+		j = key & 0x3FFFFFF;
+	}
+
+	// Return the index of a vertex of a patch in its slot.
+
+	int get_local_vertex(int a, int b) const
+	{
+		return b * (patch_segments + 1) - b * (b - 1) / 2 + a;
+	}
+
+	// Triangulate a patch, row by row, the same way as write_barycentric_row.
+	// On stitched edges, every other vertex is collapsed into the vertex 
+	// before it along the edge, and the triangles that become degenerate are
+	// skipped.
+
+	void add_patch_indices(std::vector<unsigned short>& indices, int stitched_edges) const
+	{
+		for (int b = 0; b < patch_segments; b++)
+		{
+			for (int a = 0; a < patch_segments - b; a++)
+			{
+				for (int k = 0; k < 2; k++)
+				{
+					if (k == 1 && a + 1 == patch_segments - b)
+					{
+						continue;
+					}
+
+					int triangle[3][2] =
+					{
+						{a + k, b},
+						{a + 1, b + k},
+						{a, b + 1}
+					};
+
+					unsigned short local[3];
+
+					for (int l = 0; l < 3; l++)
+					{
+						int v_a = triangle[l][0];
+						int v_b = triangle[l][1];
+
+						if (stitched_edges & 1 && v_b == 0 && v_a % 2 == 1)
+						{
+							v_a--;
+						}
+						else if (stitched_edges & 2 && v_a + v_b == patch_segments && v_a % 2 == 1)
+						{
+							v_a--;
+							v_b++;
+						}
+						else if (stitched_edges & 4 && v_a == 0 && v_b % 2 == 1)
+						{
+							v_b--;
+						}
+
+						local[l] = get_local_vertex(v_a, v_b);
+					}
+
+					if (local[0] != local[1] && local[1] != local[2] && local[2] != local[0])
+					{
+						indices.push_back(local[0]);
+						indices.push_back(local[1]);
+						indices.push_back(local[2]);
+					}
+				}
+			}
+		}
+	}
+
+	// Return the position on the unit sphere of a point on a face's lattice
+	// at a depth.
+
+	glm::vec3 get_lattice_position(int face, int depth, int i, int j) const
+	{
+		glm::vec3 c_0 = icosahedron_vertices[icosahedron_faces[face][0]];
+		glm::vec3 c_1 = icosahedron_vertices[icosahedron_faces[face][1]];
+		glm::vec3 c_2 = icosahedron_vertices[icosahedron_faces[face][2]];
+
+		return get_barycentric_position(c_0, c_1, c_2, patch_segments << depth, i, j);
+	}
+
+	// Return the key of a point on a face's lattice at a depth. Points on the
+	// edges and corners of the icosahedron are keyed by their lattice index 
+	// (see get_lattice_vertex), so that they have the same key when seen from
+	// any face. Only those indices fit in 32 bits at every depth, so the 
+	// points inside a face are keyed by their face and coordinates instead.
+
+	uint64_t get_point_key(int face, int depth, int i, int j) const
+	{
+		int n = patch_segments << depth;
+
+		uint64_t key = uint64_t(depth) << 58;
+
+		if (i == 0 || j == 0 || i + j == n)
+		{
+			return key | get_lattice_vertex(edges, n, face, i, j);
+		}
+
+		return key | (uint64_t(1) << 57) | (uint64_t(face) << 48) | (uint64_t(i) << 24) | uint64_t(j);
+	}
+
+	// Return whether a patch is hidden behind the horizon, if its terrain is
+	// at most max_radius away from the center of the planet.
+
+	bool is_patch_hidden(int face, int depth, int i, int j, int orientation, float max_radius) const
+	{
+		int s = patch_segments * orientation;
+
+		glm::vec3 c_0 = get_lattice_position(face, depth, i, j);
+		glm::vec3 c_1 = get_lattice_position(face, depth, i + s, j);
+		glm::vec3 c_2 = get_lattice_position(face, depth, i, j + s);
+
+		return is_behind_horizon(camera_position, c_0, c_1, c_2, max_radius);
+	}
+
+	// Return the split distance of the patches at a depth. A patch is split 
+	// when the distance from the camera to its bounding sphere is less than
+	// its split distance, which is when its vertices are more than threshold
+	// pixels apart on the screen. It only depends on the depth, so that 
+	// neighbouring patches morph by the same amount, and it halves with every
+	// depth, so that patches that touch differ by at most one depth. 
+	// Projecting the lattice onto the sphere stretches the patches' edges to 
+	// up to about 1.26 times the icosahedron's edge length (divided by 2 ^ 
+	// depth), which is used as the patches' size.
+
+	float get_split_distance(int depth) const
+	{
+		return std::ldexp(icosahedron_edge_length * 1.26f / patch_segments, -depth) * pixel_scale / threshold;
+	}
+
+	// Choose the patches to draw in the quadtree below a patch, which must be
+	// in a slot. parent_split_distance is the split distance of the patch's
+	// parent, or 0 for the roots.
+
+	void select_patch(int face, int depth, int i, int j, int orientation, float parent_split_distance)
+	{
+		uint64_t patch_key = get_patch_key(face, depth, i, j, orientation);
+
+		unsigned int slot = patch_slots[patch_key];
+
+		slots[slot].last_used = frame;
+
+		float split_distance = get_split_distance(depth);
+
+		float distance = std::max(glm::length(camera_position - slots[slot].center) - slots[slot].radius, 1e-6f);
+
+		if (depth < max_depth && distance < split_distance && !is_patch_hidden(face, depth, i, j, orientation, slots[slot].max_radius))
+		{
+			// Find the children. The first three share a corner with the 
+			// patch, the fourth one is in the middle and has the opposite 
+			// orientation.
+
+			int s = patch_segments * orientation;
+
+			int children[4][3] =
+			{
+				{i * 2, j * 2, orientation},
+				{i * 2 + s, j * 2, orientation},
+				{i * 2, j * 2 + s, orientation},
+				{i * 2 + s, j * 2 + s, -orientation}
+			};
+
+			bool resident = true;
+
+			for (int k = 0; k < 4; k++)
+			{
+				uint64_t key = get_patch_key(face, depth + 1, children[k][0], children[k][1], children[k][2]);
+
+				if (patch_slots.find(key) == patch_slots.end())
+				{
+					requests.push_back(std::make_pair(split_distance / distance, key));
+
+					resident = false;
+				}
+			}
+
+			if (resident)
+			{
+				for (int k = 0; k < 4; k++)
+				{
+					select_patch(face, depth + 1, children[k][0], children[k][1], children[k][2], split_distance);
+				}
+
+				return;
+			}
+		}
+
+		// Morph vertices towards the parent between the distance past which no
+		// deeper patch can touch this one, and the distance at which the 
+		// parent is merged. Before that, vertices on the patch's edges must 
+		// stay where they are, because a deeper neighbour would not morph with
+		// them. A deeper neighbour's parent is closer than the split distance,
+		// and touches this patch, so its vertices are closer than the split 
+		// distance plus its bounding sphere's diameter. Vertices are about as
+		// far away as the bounding sphere of their parent, so the patch is
+		// fully morphed when its parent is merged.
+
+		patch_draw patch;
+
+		patch.key = patch_key;
+
+		patch.slot = slot;
+
+		patch.stitched_edges = 0;
+
+		patch.morph_end = parent_split_distance;
+
+		patch.morph_start = std::min(split_distance + max_radii[depth] * 2.0f, parent_split_distance);
+
+		drawn_patches.push_back(patch);
+	}
+
+	// Find the edges of the drawn patches that border a shallower patch. The 
+	// quarter points of every drawn edge are collected first, as points of 
+	// the lattice one depth deeper. An edge of a patch borders a shallower 
+	// patch exactly when its midpoint is a quarter point of the shallower 
+	// patch's edge.
+
+	void stitch_patches()
+	{
+		quarter_points.clear();
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (size_t k = 0; k < drawn_patches.size(); k++)
+			{
+				int face;
+				int depth;
+				int i;
+				int j;
+				int orientation;
+
+				get_patch_address(drawn_patches[k].key, face, depth, i, j, orientation);
+
+				int s = patch_segments * orientation;
+
+				int corners[3][2] = {{i, j}, {i + s, j}, {i, j + s}};
+
+				for (int l = 0; l < 3; l++)
+				{
+					int* c_0 = corners[l];
+					int* c_1 = corners[(l + 1) % 3];
+
+					if (pass == 0)
+					{
+						quarter_points.insert(get_point_key(face, depth + 1, (c_0[0] * 3 + c_1[0]) / 2, (c_0[1] * 3 + c_1[1]) / 2));
+						quarter_points.insert(get_point_key(face, depth + 1, (c_0[0] + c_1[0] * 3) / 2, (c_0[1] + c_1[1] * 3) / 2));
+					}
+					else if (depth > 0 && quarter_points.count(get_point_key(face, depth, (c_0[0] + c_1[0]) / 2, (c_0[1] + c_1[1]) / 2)))
+					{
+						drawn_patches[k].stitched_edges |= 1 << l;
+					}
+				}
+			}
+		}
+	}
+
+	// Remove the drawn patches whose bounding sphere is outside of the view 
+	// frustum, or whose terrain is hidden behind the horizon, and the ones 
+	// that lie entirely at sea level if skip_submerged is true. Those are 
+	// covered by the ocean, because their parents' vertices are submerged 
+	// too, so they do not morph above sea level. This happens after 
+	// stitching, so that the patches that are drawn are stitched the same 
+	// way whether or not their neighbours are culled.
+
+	void cull_patches(const view_frustum& frustum)
+	{
+		frustum_culled_patch_count = 0;
+
+		horizon_culled_patch_count = 0;
+
+		submerged_patch_count = 0;
+
+		size_t kept = 0;
+
+		for (size_t k = 0; k < drawn_patches.size(); k++)
+		{
+			const patch_slot& slot = slots[drawn_patches[k].slot];
+
+			if (skip_submerged && slot.submerged)
+			{
+				submerged_patch_count++;
+
+				continue;
+			}
+
+			if (is_outside_frustum(frustum, slot.center, slot.radius))
+			{
+				frustum_culled_patch_count++;
+
+				continue;
+			}
+
+			int face;
+			int depth;
+			int i;
+			int j;
+			int orientation;
+
+			get_patch_address(drawn_patches[k].key, face, depth, i, j, orientation);
+
+			int s = patch_segments * orientation;
+
+			glm::vec3 c_0 = get_lattice_position(face, depth, i, j);
+			glm::vec3 c_1 = get_lattice_position(face, depth, i + s, j);
+			glm::vec3 c_2 = get_lattice_position(face, depth, i, j + s);
+
+			if (is_behind_horizon(camera_position, c_0, c_1, c_2, slot.max_radius))
+			{
+				horizon_culled_patch_count++;
+
+				continue;
+			}
+
+			drawn_patches[kept++] = drawn_patches[k];
+		}
+
+		drawn_patches.resize(kept);
+	}
+
+	// Return a slot for a new patch, evicting the least recently used patch 
+	// if every slot is in use. Returns false if every slot is in use by the
+	// current frame or by a root.
+
+	bool allocate_slot(unsigned int& slot)
+	{
+		bool found = false;
+
+		for (unsigned int i = 0; i < slots.size(); i++)
+		{
+			if (!slots[i].used)
+			{
+				slot = i;
+
+				return true;
+			}
+
+			int depth = (slots[i].key >> 53) & 31;
+
+			if (depth > 0 && slots[i].last_used < frame && (!found || slots[i].last_used < slots[slot].last_used))
+			{
+				slot = i;
+
+				found = true;
+			}
+		}
+
+		if (found)
+		{
+			patch_slots.erase(slots[slot].key);
+		}
+
+		return found;
+	}
+
+	// Generate patches and upload them to their slots.
+
+	void generate_patches(const std::vector<uint64_t>& keys)
+	{
+		if (keys.empty())
+		{
+			return;
+		}
+
+		std::vector<unsigned int> new_slots;
+
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			unsigned int slot;
+
+			if (!allocate_slot(slot))
+			{
+				break;
+			}
+
+			slots[slot].key = keys[i];
+
+			slots[slot].last_used = frame;
+
+			slots[slot].used = true;
+
+			patch_slots[keys[i]] = slot;
+
+			new_slots.push_back(slot);
+		}
+
+		// Generate the vertex data of every patch in parallel.
+
+		size_t patch_float_count = patch_vertex_count * 10;
+
+		staging.resize(new_slots.size() * patch_float_count);
+
+		get_thread_pool().parallel_for(new_slots.size(), 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				slots[new_slots[i]].submerged = !write_patch(slots[new_slots[i]].key, &staging[i * patch_float_count]);
+			}
+		});
+
+		// Find the bounding sphere of every patch from its vertices, and keep 
+		// track of the largest bounding sphere at every depth.
+
+		for (size_t i = 0; i < new_slots.size(); i++)
+		{
+			patch_slot& slot = slots[new_slots[i]];
+
+			const float* vertices = &staging[i * patch_float_count];
+
+			slot.center = glm::vec3(0.0f);
+
+			for (int j = 0; j < patch_vertex_count; j++)
+			{
+				slot.center += glm::vec3(vertices[j * 10 + 0], vertices[j * 10 + 1], vertices[j * 10 + 2]);
+			}
+
+			slot.center /= float(patch_vertex_count);
+
+			slot.radius = 0.0f;
+
+			slot.max_radius = 0.0f;
+
+			for (int j = 0; j < patch_vertex_count; j++)
+			{
+				glm::vec3 position = glm::vec3(vertices[j * 10 + 0], vertices[j * 10 + 1], vertices[j * 10 + 2]);
+
+				slot.radius = std::max(slot.radius, glm::length(position - slot.center));
+
+				slot.max_radius = std::max(slot.max_radius, glm::length(position));
+			}
+
+			int depth = (slot.key >> 53) & 31;
+
+			max_radii[depth] = std::max(max_radii[depth], slot.radius);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+		for (size_t i = 0; i < new_slots.size(); i++)
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, new_slots[i] * patch_float_count * sizeof(float), patch_float_count * sizeof(float), &staging[i * patch_float_count]);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Write the interleaved vertex data of a patch, and return whether any 
+	// of its vertices are above sea level.
+
+	bool write_patch(uint64_t key, float* vertices) const
+	{
+		bool above_sea_level = false;
+
+		int face;
+		int depth;
+		int i;
+		int j;
+		int orientation;
+
+		get_patch_address(key, face, depth, i, j, orientation);
+
+		// Perturb a grid that is one vertex larger than the patch on every 
+		// side, so that the normals on the patch's border can be found from 
+		// the vertices around them. Outside of the face, the lattice simply 
+		// continues in the face's plane.
+
+		int extended_segments = patch_segments + 3;
+
+		int extended_row = extended_segments + 1;
+
+		std::vector<glm::vec3> positions(extended_row * extended_row);
+
+		std::vector<float> noise_map(extended_row * extended_row);
+
+		for (int b = 0; b <= extended_segments; b++)
+		{
+			for (int a = 0; a + b <= extended_segments; a++)
+			{
+				glm::vec3 vertex = get_lattice_position(face, depth, i + (a - 1) * orientation, j + (b - 1) * orientation);
+
+				float noise_value = get_terrain_noise(*noise_1, *noise_2, vertex);
+
+				noise_map[b * extended_row + a] = noise_value;
+
+				positions[b * extended_row + a] = get_terrain_position(vertex, noise_value);
+			}
+		}
+
+		// Write the vertices of the patch itself.
+
+		const int ring[6][2] = {{1, 0}, {0, 1}, {-1, 1}, {-1, 0}, {0, -1}, {1, -1}};
+
+		for (int b = 0; b <= patch_segments; b++)
+		{
+			for (int a = 0; a + b <= patch_segments; a++)
+			{
+				int center = (b + 1) * extended_row + (a + 1);
+
+				glm::vec3 position = positions[center];
+
+				// Accumulate the normals of the 6 triangles around the vertex.
+				// Rotating the patch by 180 degrees does not change the 
+				// winding of the ring.
+
+				glm::vec3 normal = glm::vec3(0.0f);
+
+				for (int k = 0; k < 6; k++)
+				{
+					glm::vec3 p_1 = positions[center + ring[k][1] * extended_row + ring[k][0]];
+					glm::vec3 p_2 = positions[center + ring[(k + 1) % 6][1] * extended_row + ring[(k + 1) % 6][0]];
+
+					normal += glm::cross(p_1 - position, p_2 - position);
+				}
+
+				normal = glm::normalize(normal);
+
+				// Find the height of the parent at the vertex. Vertices with
+				// even coordinates also exist in the parent, the others lie on
+				// an edge of the parent's grid, between two of its vertices.
+				// The parent's edges run along (1, 0), (0, 1) and (1, -1).
+
+				float morph_height = 0.0f;
+
+				if (a % 2 == 1 || b % 2 == 1)
+				{
+					int di = a % 2;
+					int dj = b % 2;
+
+					if (di == 1 && dj == 1)
+					{
+						dj = -1;
+					}
+
+					float height_1 = glm::length(positions[center + dj * extended_row + di]);
+					float height_2 = glm::length(positions[center - dj * extended_row - di]);
+
+					morph_height = (height_1 + height_2) * 0.5f - glm::length(position);
+				}
+
+				above_sea_level = above_sea_level || noise_map[center] > 0.0f;
+
+				utils::Color color = color_map->GetColor(noise_map[center]);
+
+				float* vertex = vertices + get_local_vertex(a, b) * 10;
+
+				vertex[0] = position.x;
+				vertex[1] = position.y;
+				vertex[2] = position.z;
+
+				vertex[3] = color.red / 255.0f;
+				vertex[4] = color.green / 255.0f;
+				vertex[5] = color.blue / 255.0f;
+
+				vertex[6] = normal.x;
+				vertex[7] = normal.y;
+				vertex[8] = normal.z;
+
+				vertex[9] = morph_height;
+			}
+		}
+
+		return above_sea_level;
+	}
+
+	const noise::module::Perlin* noise_1;
+
+	const noise::module::RidgedMulti* noise_2;
+
+	const noise::utils::GradientColor* color_map;
+
+	bool skip_submerged;
+
+	std::vector<glm::vec3> icosahedron_vertices;
+
+	icosahedron_edges edges;
+
+	float icosahedron_edge_length;
+
+	int patch_segments;
+
+	int max_depth;
+
+	// The largest bounding sphere of any patch at every depth.
+
+	std::vector<float> max_radii;
+
+	int patch_vertex_count;
+
+	// The amount of indices in, and the offset in bytes of, the 
+	// triangulation for every combination of stitched edges.
+
+	GLsizei stitch_index_counts[8];
+
+	size_t stitch_index_offsets[8];
+
+	// The slots of the vertex buffer, and the slot of every patch that is in
+	// the vertex buffer.
+
+	std::vector<patch_slot> slots;
+
+	std::unordered_map<uint64_t, unsigned int> patch_slots;
+
+	// The state of the current frame.
+
+	unsigned int frame;
+
+	glm::vec3 camera_position;
+
+	float pixel_scale;
+
+	float threshold;
+
+	std::vector<patch_draw> drawn_patches;
+
+	std::unordered_set<uint64_t> quarter_points;
+
+	std::vector<std::pair<float, uint64_t>> requests;
+
+	size_t drawn_triangle_count;
+
+	size_t frustum_culled_patch_count;
+
+	size_t horizon_culled_patch_count;
+
+	size_t submerged_patch_count;
+
+	// Space for the vertex data of newly generated patches.
+
+	std::vector<float> staging;
+
+	GLuint vao;
+	GLuint vbo;
+	GLuint ebo;
+};
+
+/*
+
+A roam_planet draws the planet as a triangle bintree, refined continuously by
+split and merge priority queues (ROAM) so that the amount of triangles never
+exceeds a fixed budget. The 20 faces of the icosahedron are paired into 10 
+diamonds, so that every triangle's base is shared with another triangle. A 
+triangle is split at the midpoint of its base, together with the triangle on
+the other side of its base. If that triangle's base is a different edge, it 
+is split first (a forced split).
+
+Every frame, the priorities of the triangles are recomputed for the camera,
+and the triangle with the highest priority is split, or the diamond with the
+lowest priority is merged, until no split would improve the planet without 
+going over the budget.
+
+*/
+
+class roam_planet
+{
+public:
+
+	roam_planet
+	(
+		const noise::module::Perlin& noise_1,
+		const noise::module::RidgedMulti& noise_2,
+		const noise::utils::GradientColor& color_map,
+
+		size_t triangle_budget = 65536
+	)
+	{
+		this->noise_1 = &noise_1;
+		this->noise_2 = &noise_2;
+
+		this->color_map = &color_map;
+
+		this->triangle_budget = std::max(triangle_budget, size_t(20));
+
+		triangle_count = 20;
+
+		camera_position = glm::vec3(0.0f, 0.0f, 2.0f);
+
+		pixel_scale = 1.0f;
+
+		max_radius = get_sampled_max_radius();
+
+		// Add the vertices of the icosahedron.
+
+		std::vector<glm::vec3> icosahedron_vertices;
+
+		add_icosahedron_vertices(icosahedron_vertices);
+
+		for (int i = 0; i < 12; i++)
+		{
+			add_vertex(icosahedron_vertices[i], get_terrain_noise(noise_1, noise_2, icosahedron_vertices[i]), 0.01f);
+		}
+
+		// Pair every face with a neighbouring face. The shared edge becomes 
+		// the base of both faces.
+
+		icosahedron_edges edges = create_icosahedron_edges();
+
+		int partners[20];
+
+		std::fill(partners, partners + 20, -1);
+
+		pair_faces(edges, partners, 0);
+
+		// Create the roots. The apex of every root is the corner that is not
+		// on its base, the corners stay in counter-clockwise order.
+
+		for (int i = 0; i < 20; i++)
+		{
+			int apex = 0;
+
+			while (is_face_corner(partners[i], icosahedron_faces[i][apex]))
+			{
+				apex++;
+			}
+
+			int corners[3] =
+			{
+				icosahedron_faces[i][apex],
+				icosahedron_faces[i][(apex + 1) % 3],
+				icosahedron_faces[i][(apex + 2) % 3]
+			};
+
+			create_triangle(corners, -1, 0.0f);
+		}
+
+		// Connect the roots to their neighbours. Neighbour 0 is across the
+		// base, 1 is across the edge from the apex to the left corner and 2 
+		// is across the edge from the right corner to the apex.
+
+		for (int i = 0; i < 20; i++)
+		{
+			int* v = triangles[i].vertices;
+
+			int sides[3][2] = {{v[1], v[2]}, {v[0], v[1]}, {v[2], v[0]}};
+
+			for (int j = 0; j < 3; j++)
+			{
+				for (int k = 0; k < 20; k++)
+				{
+					if (k != i && is_face_corner(k, sides[j][0]) && is_face_corner(k, sides[j][1]))
+					{
+						triangles[i].neighbours[j] = k;
+					}
+				}
+			}
+		}
+
+		// Create the VAO, the VBO and the EBO. Both buffers are uploaded every
+		// frame that the bintree changes.
+
+		glGenVertexArrays(1, &vao);
+
+		glGenBuffers(1, &vbo);
+		glGenBuffers(1, &ebo);
+
+		glBindVertexArray(vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(0 * sizeof(float)));
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(3 * sizeof(float)));
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(6 * sizeof(float)));
+
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glBindVertexArray(0);
+
+		changed = true;
+	}
+
+	~roam_planet()
+	{
+		glDeleteVertexArrays(1, &vao);
+
+		glDeleteBuffers(1, &vbo);
+		glDeleteBuffers(1, &ebo);
+	}
+
+	// Refine the bintree for a camera with up to operation_limit splits and
+	// merges. camera_position is in model space, and pixel_scale is the 
+	// viewport's height in pixels divided by 2 * tan(fov / 2). More merges 
+	// are made if the budget was lowered below the amount of triangles.
+
+	void update(glm::vec3 camera_position, float pixel_scale, size_t operation_limit = 1024)
+	{
+		this->camera_position = camera_position;
+
+		this->pixel_scale = pixel_scale;
+
+		// Recompute every priority, and rebuild the queues.
+
+		split_queue.clear();
+		merge_queue.clear();
+
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			roam_triangle& triangle = triangles[i];
+
+			if (triangle.vertices[0] < 0)
+			{
+				continue;
+			}
+
+			triangle.priority = get_priority(i);
+
+			if (triangle.children[0] < 0)
+			{
+				split_queue.insert(std::make_pair(triangle.priority, int(i)));
+			}
+		}
+
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			triangles[i].merge_queued = false;
+
+			if (triangles[i].vertices[0] >= 0)
+			{
+				update_diamond(i);
+			}
+		}
+
+		// Split and merge.
+
+		for (size_t i = 0; i < operation_limit || triangle_count > triangle_budget; i++)
+		{
+			bool can_split = !split_queue.empty() && split_queue.rbegin()->first > 0.0f;
+
+			bool can_merge = !merge_queue.empty();
+
+			if (triangle_count > triangle_budget && can_merge)
+			{
+				merge(merge_queue.begin()->second);
+
+				continue;
+			}
+
+			if (!can_split)
+			{
+				break;
+			}
+
+			int best = split_queue.rbegin()->second;
+
+			if (triangle_count + get_split_cost(best) <= triangle_budget)
+			{
+				split(best);
+			}
+			else if (can_merge && merge_queue.begin()->first < split_queue.rbegin()->first)
+			{
+				merge(merge_queue.begin()->second);
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		// Upload the vertices and the leaves of the bintree.
+
+		if (changed)
+		{
+			std::vector<unsigned int> indices;
+
+			indices.reserve(triangle_count * 3);
+
+			for (std::set<std::pair<float, int>>::iterator i = split_queue.begin(); i != split_queue.end(); i++)
+			{
+				int* v = triangles[i->second].vertices;
+
+				indices.push_back(v[0]);
+				indices.push_back(v[1]);
+				indices.push_back(v[2]);
+			}
+
+			index_count = indices.size();
+
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+			glBufferData(GL_ARRAY_BUFFER, vertex_data.size() * sizeof(float), &vertex_data[0], GL_STREAM_DRAW);
+
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			glBindVertexArray(vao);
+
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STREAM_DRAW);
+
+			glBindVertexArray(0);
+
+			changed = false;
+		}
+	}
+
+	// Draw the leaves of the bintree.
+
+	void draw() const
+	{
+		glBindVertexArray(vao);
+
+		glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, (void*)0);
+
+		glBindVertexArray(0);
+	}
+
+	// Set the triangle budget. It is met by the next call to update.
+
+	void set_triangle_budget(size_t triangle_budget)
+	{
+		this->triangle_budget = std::max(triangle_budget, size_t(20));
+	}
+
+	// Return the amount of triangles in the bintree's leaves.
+
+	size_t get_triangle_count() const
+	{
+		return triangle_count;
+	}
+
+private:
+
+	// A triangle of the bintree.
+
+	struct roam_triangle
+	{
+		// The apex, left and right corners, in counter-clockwise order. The
+		// base runs from the left corner to the right corner. Triangles on 
+		// the free list have a negative apex.
+
+		int vertices[3];
+
+		// The triangles across the base, across the edge from the apex to 
+		// the left corner, and across the edge from the right corner to the
+		// apex.
+
+		int neighbours[3];
+
+		int parent;
+
+		// The children, or -1 for leaves. The first child holds the left
+		// corner, the second child holds the right corner.
+
+		int children[2];
+
+		// The noise value at the midpoint of the base.
+
+		float midpoint_noise;
+
+		// The distance between the midpoint of the base and the base, bounded
+		// by the error of the parent, and the error projected onto the 
+		// screen.
+
+		float error;
+
+		float priority;
+
+		// Whether the triangle's diamond is in the merge queue, and with which
+		// priority. Only used on the diamond's triangle with the lower index.
+
+		bool merge_queued;
+
+		float merge_priority;
+	};
+
+	// Pair the faces of the icosahedron, starting from a face, by searching 
+	// for a perfect matching. Returns false if there is none.
+
+	bool pair_faces(const icosahedron_edges& edges, int* partners, int face)
+	{
+		while (face < 20 && partners[face] >= 0)
+		{
+			face++;
+		}
+
+		if (face == 20)
+		{
+			return true;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			int edge = edges.face_edges[face][i];
+
+			int other = edges.faces[edge][0] == face ? edges.faces[edge][1] : edges.faces[edge][0];
+
+			if (partners[other] < 0)
+			{
+				partners[face] = other;
+				partners[other] = face;
+
+				if (pair_faces(edges, partners, face + 1))
+				{
+					return true;
+				}
+
+				partners[face] = -1;
+				partners[other] = -1;
+			}
+		}
+
+		return false;
+	}
+
+	// Return whether a vertex is a corner of a face of the icosahedron.
+
+	bool is_face_corner(int face, int vertex) const
+	{
+		return icosahedron_faces[face][0] == vertex || icosahedron_faces[face][1] == vertex || icosahedron_faces[face][2] == vertex;
+	}
+
+	// Return the perturbed position of a direction.
+
+	glm::vec3 get_position(glm::vec3 direction) const
+	{
+		return get_terrain_position(direction, get_terrain_noise(*noise_1, *noise_2, direction));
+	}
+
+	// Return the largest distance from the center of the planet of the 
+	// terrain at 16384 points spread evenly over the planet (on a Fibonacci
+	// spiral). This is where max_radius starts, so that peaks that have not
+	// been generated yet are not all taken to be hidden in the first frames.
+
+	float get_sampled_max_radius() const
+	{
+		const size_t sample_count = 16384;
+
+		std::vector<glm::vec3> samples(sample_count);
+
+		for (size_t i = 0; i < sample_count; i++)
+		{
+			float y = 1.0f - 2.0f * (i + 0.5f) / sample_count;
+
+			float r = std::sqrt(1.0f - y * y);
+
+			float angle = i * 2.39996323f;
+
+			samples[i] = glm::vec3(r * std::cos(angle), y, r * std::sin(angle));
+		}
+
+		std::vector<float> noise_values(sample_count);
+
+		get_terrain_noise_values(*noise_1, *noise_2, &samples[0], &noise_values[0], sample_count);
+
+		float result = 1.0f;
+
+		for (size_t i = 0; i < sample_count; i++)
+		{
+			result = std::max(result, glm::length(get_terrain_position(samples[i], noise_values[i])));
+		}
+
+		return result;
+	}
+
+	// Add a vertex at a direction with a noise value. The normal is found 
+	// from two more points on the terrain, offset by about spacing.
+
+	int add_vertex(glm::vec3 direction, float noise_value, float spacing)
+	{
+		glm::vec3 position = get_terrain_position(direction, noise_value);
+
+		max_radius = std::max(max_radius, glm::length(position));
+
+		glm::vec3 tangent_1 = glm::normalize(glm::cross(direction, std::fabs(direction.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f)));
+		glm::vec3 tangent_2 = glm::cross(direction, tangent_1);
+
+		glm::vec3 position_1 = get_position(glm::normalize(direction + tangent_1 * spacing));
+		glm::vec3 position_2 = get_position(glm::normalize(direction + tangent_2 * spacing));
+
+		glm::vec3 normal = glm::normalize(glm::cross(position_1 - position, position_2 - position));
+
+		utils::Color color = color_map->GetColor(noise_value);
+
+		int vertex;
+
+		if (free_vertices.empty())
+		{
+			vertex = directions.size();
+
+			directions.push_back(direction);
+
+			vertex_data.resize(vertex_data.size() + 9);
+		}
+		else
+		{
+			vertex = free_vertices.back();
+
+			free_vertices.pop_back();
+
+			directions[vertex] = direction;
+		}
+
+		float* data = &vertex_data[vertex * 9];
+
+		data[0] = position.x;
+		data[1] = position.y;
+		data[2] = position.z;
+
+		data[3] = color.red / 255.0f;
+		data[4] = color.green / 255.0f;
+		data[5] = color.blue / 255.0f;
+
+		data[6] = normal.x;
+		data[7] = normal.y;
+		data[8] = normal.z;
+
+		return vertex;
+	}
+
+	glm::vec3 get_vertex_position(int vertex) const
+	{
+		return glm::vec3(vertex_data[vertex * 9 + 0], vertex_data[vertex * 9 + 1], vertex_data[vertex * 9 + 2]);
+	}
+
+	// Create a triangle, and find its error from the noise at the midpoint of
+	// its base. Its neighbours are left for the caller.
+
+	int create_triangle(const int* vertices, int parent, float parent_error)
+	{
+		roam_triangle triangle;
+
+		for (int i = 0; i < 3; i++)
+		{
+			triangle.vertices[i] = vertices[i];
+
+			triangle.neighbours[i] = -1;
+		}
+
+		triangle.parent = parent;
+
+		triangle.children[0] = -1;
+		triangle.children[1] = -1;
+
+		glm::vec3 midpoint = glm::normalize(directions[vertices[1]] + directions[vertices[2]]);
+
+		triangle.midpoint_noise = get_terrain_noise(*noise_1, *noise_2, midpoint);
+
+		glm::vec3 midpoint_position = get_terrain_position(midpoint, triangle.midpoint_noise);
+
+		max_radius = std::max(max_radius, glm::length(midpoint_position));
+
+		triangle.error = glm::length(midpoint_position - (get_vertex_position(vertices[1]) + get_vertex_position(vertices[2])) * 0.5f);
+
+		// Keep the errors nested, so that a child never has a larger error 
+		// than its parent, and let them shrink by at most half per level, so
+		// that flat spots do not stop the refinement of the terrain below 
+		// them.
+
+		if (parent >= 0)
+		{
+			triangle.error = std::min(parent_error, std::max(triangle.error, parent_error * 0.5f));
+		}
+
+		triangle.priority = 0.0f;
+
+		triangle.merge_queued = false;
+
+		triangle.merge_priority = 0.0f;
+
+		int index;
+
+		if (free_triangles.empty())
+		{
+			index = triangles.size();
+
+			triangles.push_back(triangle);
+		}
+		else
+		{
+			index = free_triangles.back();
+
+			free_triangles.pop_back();
+
+			triangles[index] = triangle;
+		}
+
+		return index;
+	}
+
+	// Return the priority of a triangle, which is its error projected onto
+	// the screen, or 0 if it is hidden behind the horizon.
+
+	float get_priority(int index) const
+	{
+		const roam_triangle& triangle = triangles[index];
+
+		const int* v = triangle.vertices;
+
+		if (is_behind_horizon(camera_position, directions[v[0]], directions[v[1]], directions[v[2]], max_radius))
+		{
+			return 0.0f;
+		}
+
+		glm::vec3 p_0 = get_vertex_position(v[0]);
+		glm::vec3 p_1 = get_vertex_position(v[1]);
+		glm::vec3 p_2 = get_vertex_position(v[2]);
+
+		glm::vec3 center = (p_0 + p_1 + p_2) / 3.0f;
+
+		float radius = std::max(glm::length(p_0 - center), std::max(glm::length(p_1 - center), glm::length(p_2 - center)));
+
+		float distance = std::max(glm::length(camera_position - center) - radius, 1e-6f);
+
+		return triangle.error * pixel_scale / distance;
+	}
+
+	// Replace a triangle's neighbour.
+
+	void replace_neighbour(int index, int old_neighbour, int new_neighbour)
+	{
+		if (index < 0)
+		{
+			return;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (triangles[index].neighbours[i] == old_neighbour)
+			{
+				triangles[index].neighbours[i] = new_neighbour;
+			}
+		}
+	}
+
+	// Return the amount of triangles that splitting a triangle would add,
+	// including the forced splits.
+
+	size_t get_split_cost(int index) const
+	{
+		size_t cost = 2;
+
+		while (triangles[triangles[index].neighbours[0]].neighbours[0] != index)
+		{
+			index = triangles[index].neighbours[0];
+
+			cost += 2;
+		}
+
+		return cost;
+	}
+
+	// Split a triangle and the triangle across its base, after forcing that
+	// triangle to share its base if it does not.
+
+	void split(int index)
+	{
+		if (triangles[triangles[index].neighbours[0]].neighbours[0] != index)
+		{
+			split(triangles[index].neighbours[0]);
+		}
+
+		int t = index;
+		int b = triangles[index].neighbours[0];
+
+		// Both triangles share the midpoint of their base.
+
+		int* v_t = triangles[t].vertices;
+
+		float spacing = glm::length(directions[v_t[1]] - directions[v_t[2]]) * 0.25f;
+
+		int midpoint = add_vertex(glm::normalize(directions[v_t[1]] + directions[v_t[2]]), triangles[t].midpoint_noise, spacing);
+
+		int pair[2] = {t, b};
+
+		int children[2][2];
+
+		for (int i = 0; i < 2; i++)
+		{
+			roam_triangle parent = triangles[pair[i]];
+
+			int left_child[3] = {midpoint, parent.vertices[0], parent.vertices[1]};
+			int right_child[3] = {midpoint, parent.vertices[2], parent.vertices[0]};
+
+			children[i][0] = create_triangle(left_child, pair[i], parent.error);
+			children[i][1] = create_triangle(right_child, pair[i], parent.error);
+
+			triangles[pair[i]].children[0] = children[i][0];
+			triangles[pair[i]].children[1] = children[i][1];
+		}
+
+		// Connect the children to each other, and to the outer neighbours.
+
+		for (int i = 0; i < 2; i++)
+		{
+			roam_triangle& parent = triangles[pair[i]];
+
+			roam_triangle& left_child = triangles[children[i][0]];
+			roam_triangle& right_child = triangles[children[i][1]];
+
+			left_child.neighbours[0] = parent.neighbours[1];
+			left_child.neighbours[1] = children[i][1];
+			left_child.neighbours[2] = children[1 - i][1];
+
+			right_child.neighbours[0] = parent.neighbours[2];
+			right_child.neighbours[1] = children[1 - i][0];
+			right_child.neighbours[2] = children[i][0];
+
+			replace_neighbour(parent.neighbours[1], pair[i], children[i][0]);
+			replace_neighbour(parent.neighbours[2], pair[i], children[i][1]);
+		}
+
+		// Update the queues.
+
+		for (int i = 0; i < 2; i++)
+		{
+			split_queue.erase(std::make_pair(triangles[pair[i]].priority, pair[i]));
+
+			for (int j = 0; j < 2; j++)
+			{
+				roam_triangle& child = triangles[children[i][j]];
+
+				child.priority = get_priority(children[i][j]);
+
+				split_queue.insert(std::make_pair(child.priority, children[i][j]));
+			}
+		}
+
+		for (int i = 0; i < 2; i++)
+		{
+			update_diamond(pair[i]);
+
+			if (triangles[pair[i]].parent >= 0)
+			{
+				update_diamond(triangles[pair[i]].parent);
+			}
+		}
+
+		triangle_count += 2;
+
+		changed = true;
+	}
+
+	// Merge a diamond back into the two triangles that it was split from.
+
+	void merge(int index)
+	{
+		int t = index;
+		int b = triangles[index].neighbours[0];
+
+		int pair[2] = {t, b};
+
+		remove_diamond(t);
+
+		free_vertices.push_back(triangles[triangles[t].children[0]].vertices[0]);
+
+		for (int i = 0; i < 2; i++)
+		{
+			roam_triangle& parent = triangles[pair[i]];
+
+			int left_child = parent.children[0];
+			int right_child = parent.children[1];
+
+			// Take the outer neighbours back from the children.
+
+			parent.neighbours[1] = triangles[left_child].neighbours[0];
+			parent.neighbours[2] = triangles[right_child].neighbours[0];
+
+			replace_neighbour(parent.neighbours[1], left_child, pair[i]);
+			replace_neighbour(parent.neighbours[2], right_child, pair[i]);
+
+			for (int j = 0; j < 2; j++)
+			{
+				int child = parent.children[j];
+
+				split_queue.erase(std::make_pair(triangles[child].priority, child));
+
+				triangles[child].vertices[0] = -1;
+
+				free_triangles.push_back(child);
+
+				parent.children[j] = -1;
+			}
+
+			parent.priority = get_priority(pair[i]);
+
+			split_queue.insert(std::make_pair(parent.priority, pair[i]));
+		}
+
+		for (int i = 0; i < 2; i++)
+		{
+			if (triangles[pair[i]].parent >= 0)
+			{
+				update_diamond(triangles[pair[i]].parent);
+			}
+		}
+
+		triangle_count -= 2;
+
+		changed = true;
+	}
+
+	// Add a triangle's diamond to the merge queue if it can be merged, or 
+	// remove it otherwise. A diamond can be merged when both of its 
+	// triangles are split and all 4 children are leaves.
+
+	void update_diamond(int index)
+	{
+		const roam_triangle& triangle = triangles[index];
+
+		int b = triangle.neighbours[0];
+
+		bool mergeable = triangle.children[0] >= 0 && triangles[b].children[0] >= 0 && triangles[b].neighbours[0] == index;
+
+		for (int i = 0; i < 2 && mergeable; i++)
+		{
+			mergeable = triangles[triangle.children[i]].children[0] < 0 && triangles[triangles[b].children[i]].children[0] < 0;
+		}
+
+		remove_diamond(index);
+
+		if (mergeable)
+		{
+			roam_triangle& key = triangles[std::min(index, b)];
+
+			key.merge_queued = true;
+
+			key.merge_priority = std::max(triangle.priority, triangles[b].priority);
+
+			merge_queue.insert(std::make_pair(key.merge_priority, std::min(index, b)));
+		}
+	}
+
+	// Remove a triangle's diamond from the merge queue.
+
+	void remove_diamond(int index)
+	{
+		int key = std::min(index, triangles[index].neighbours[0]);
+
+		if (triangles[key].merge_queued)
+		{
+			merge_queue.erase(std::make_pair(triangles[key].merge_priority, key));
+
+			triangles[key].merge_queued = false;
+		}
+	}
+
+	const noise::module::Perlin* noise_1;
+
+	const noise::module::RidgedMulti* noise_2;
+
+	const noise::utils::GradientColor* color_map;
+
+	// The triangles of the bintree, and the ones that are free to reuse.
+
+	std::vector<roam_triangle> triangles;
+
+	std::vector<int> free_triangles;
+
+	// The directions of the vertices, their interleaved vertex data, and the
+	// vertices that are free to reuse.
+
+	std::vector<glm::vec3> directions;
+
+	std::vector<float> vertex_data;
+
+	std::vector<int> free_vertices;
+
+	// The leaves ordered by priority, and the diamonds that can be merged 
+	// ordered by priority.
+
+	std::set<std::pair<float, int>> split_queue;
+
+	std::set<std::pair<float, int>> merge_queue;
+
+	size_t triangle_budget;
+
+	size_t triangle_count;
+
+	glm::vec3 camera_position;
+
+	float pixel_scale;
+
+	// The largest distance from the center of the planet of the terrain that
+	// has been generated, at the vertices and at the midpoints of the 
+	// triangles. Nothing that is drawn lies further out, so triangles behind
+	// the horizon for this radius are hidden.
+
+	float max_radius;
+
+	// Whether the bintree changed since it was last uploaded.
+
+	bool changed;
+
+	GLsizei index_count;
+
+	GLuint vao;
+	GLuint vbo;
+	GLuint ebo;
+};
+
+/*
+
+Load a shader program from two files.
+
+*/
+
+GLuint load_shader_program
+(
+	std::string shader_path_0,
+	std::string shader_path_1,
+
+	GLenum shader_type_0,
+	GLenum shader_type_1
+)
+{
+	// Open shader_path_0 and shader_path_1 as input file streams.
+
+	std::ifstream shader_file_0(shader_path_0);
+	std::ifstream shader_file_1(shader_path_1);
+
+	if (!shader_file_0.is_open())
+	{
+		std::cout << "Could not open file \"" << shader_path_0 << "\"." << std::endl;
+
+		exit(EXIT_FAILURE);
+	}
+	else if (!shader_file_1.is_open())
+	{
+		std::cout << "Could not open file \"" << shader_path_1 << "\"." << std::endl;
+
+		exit(EXIT_FAILURE);
+	}
+
+	// Load the text context of shader_path_0 and shader_path_1 into 
+	// shader_buffer_0 and shader_buffer_1.
+
+	std::stringstream shader_buffer_0;
+	std::stringstream shader_buffer_1;
+
+	shader_buffer_0 << shader_file_0.rdbuf() << "\0";
+	shader_buffer_1 << shader_file_1.rdbuf() << "\0";
+
+	// Convert shader_buffer_0 and shader_buffer_1 from std::stringstream to
+	// std::string, and then to const GLchar* (const char*).
+
+	std::string shader_text_0 = shader_buffer_0.str();
+	std::string shader_text_1 = shader_buffer_1.str();
+
+	const GLchar* shader_data_0 = shader_text_0.c_str();
+	const GLchar* shader_data_1 = shader_text_1.c_str();
+
+	// Create shader_0 and shader_1 with the types shader_type_0 and 
+	// shader_type_1, then source them with shader_data_0 and shader_data_1.
+
+	GLuint shader_0 = glCreateShader(shader_type_0);
+	GLuint shader_1 = glCreateShader(shader_type_1);
+
+	glShaderSource(shader_0, 1, &shader_data_0, NULL);
+	glShaderSource(shader_1, 1, &shader_data_1, NULL);
+
+	// Compile shader_0 and shader_1.
+
+	glCompileShader(shader_0);
+	glCompileShader(shader_1);
+
+	// Check if shader_0 or shader_1 failed compilation. If so, print out the
+	// error message provided by OpenGL.
+
+	GLint success_0 = 0;
+	GLint success_1 = 0;
+
+	GLchar crash_information_0[16 * 1024];
+	GLchar crash_information_1[16 * 1024];
+
+	glGetShaderiv(shader_0, GL_COMPILE_STATUS, &success_0);
+	glGetShaderiv(shader_1, GL_COMPILE_STATUS, &success_1);
+
+	if (!success_0)
+	{
+		std::cout << "Could not compile shader loaded from \"" << shader_path_0 << "\"." << std::endl;
+
+		glGetShaderInfoLog(shader_0, 16 * 1024, NULL, crash_information_0);
+
+		std::cout << crash_information_0;
+
+		exit(EXIT_FAILURE);
+	}
+	else if (!success_1)
+	{
+		std::cout << "Could not compile shader loaded from \"" << shader_path_1 << "\"." << std::endl;
+
+		glGetShaderInfoLog(shader_1, 16 * 1024, NULL, crash_information_1);
+
+		std::cout << crash_information_1;
+
+		exit(EXIT_FAILURE);
+	}
+
+	// Create an empty shader program.
+
+	GLuint shader_program = glCreateProgram();
+
+	// Attach shader_0 and shader_1 to shader_program, and then link 
+	// shader_program.
+
+	glAttachShader(shader_program, shader_0);
+	glAttachShader(shader_program, shader_1);
+
+	glLinkProgram(shader_program);
+
+	// Check if shader_program failed linkage. If so, print out the error 
+	// message provied by OpenGL.
+
+	GLint success_program = 0;
+
+	glGetProgramiv(shader_program, GL_LINK_STATUS, &success_program);
+
+	if (!success_program)
+	{
+		std::cout << "Could not link shader program loaded from \"" << shader_path_0 << "\" and \"" << shader_path_1 << "\"." << std::endl;
+
+		GLchar crash_information_program[16 * 1024];
+
+		glGetProgramInfoLog(shader_program, 16 * 1024, NULL, crash_information_program);
+
+		std::cout << crash_information_program;
+
+		exit(EXIT_FAILURE);
+	}
+
+	// Delete shader_0 and shader_1, then return shader_program.
+
+	glDeleteShader(shader_0);
+	glDeleteShader(shader_1);
+
+	return shader_program;
+}
+
+/*
+
+Entry point.
+
+*/
+
+int main(int argc, char** argv)
+{
+	// Initialize SDL.
+
+	if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
+	{
+		std::cout << "Could not initialize SDL." << std::endl;
+
+		return EXIT_FAILURE;
+	}
+
+	// Create a SDL_Window*.
+
+	int sdl_x_res = 960;
+	int sdl_y_res = 960;
+
+	SDL_Window* sdl_window = SDL_CreateWindow
+	(
+		"SDL 2.0 with OpenGL 3.3 Core",
+
+		SDL_WINDOWPOS_UNDEFINED,
+		SDL_WINDOWPOS_UNDEFINED,
+
+		sdl_x_res,
+		sdl_y_res,
+
+		SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL
+	);
+
+	// Make sure the SDL_Window* was created successfully.
+
+	if (!sdl_window)
+	{
+		std::cout << "Could not create a SDL_Window*." << std::endl;
+
+		return EXIT_FAILURE;
+	}
+
+	// Request OpenGL 3.3 Core.
+
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+	// Create a SDL_GLContext.
+
+	SDL_GLContext gl_context = SDL_GL_CreateContext(sdl_window);
+
+	// Make sure the SDL_GLContext was created successfully.
+
+	if (!gl_context)
+	{
+		std::cout << "Could not create a SDL_GLContext." << std::endl;
+
+		return EXIT_FAILURE;
+	}
+
+	// Load all OpenGL 3.3 Core functions using GLAD.
+
+	if (!gladLoadGLLoader(SDL_GL_GetProcAddress)) 
+	{
+		std::cout << "Could not load OpenGL 3.3 Core functions using GLAD." << std::endl;
+
+		return EXIT_FAILURE;
+	}
+
+	// Make sure the OpenGL version that was loaded by GLAD is greater than or
+	// equal to OpenGL 3.3.
+
+	if (GLVersion.major * 10 + GLVersion.minor < 33)
+	{
+		std::cout << "Could not load OpenGL 3.3 Core functions using GLAD." << std::endl;
+
+		return EXIT_FAILURE;
+	}
+
+	// Choose the seed of the planet. A seed may be given as the first 
+	// argument, otherwise the current time is used, so that the planet will 
+	// be slightly different every time. Only planets with a given seed are
+	// cached, since other seeds are unlikely to be seen again.
+
+	bool planet_seeded = argc > 1;
+
+	int planet_seed = planet_seeded ? atoi(argv[1]) : time(NULL);
+
+	// Choose whether to report how the planet was generated or loaded on the
+	// standard output. Errors are always reported.
+
+	bool planet_verbose = false;
+
+	// Choose the amount of subdivisions of the icosphere.
+
+	const int icosphere_subdivisions = 8;
+
+	// Create and initialize a noise::module::Perlin. This noise module will
+	// dictate the general shape of the islands on the planet.
+
+	noise::module::Perlin noise_1;
+
+	{
+		// Set the seed to the seed of the planet.
+
+		noise_1.SetSeed(planet_seed);
+
+		// Set the octave count to 16 for a high level of detail.
+
+		noise_1.SetOctaveCount(16);
+
+		// Set the frequency to 2.0f to make the noise more random and less
+		// coherent.
+
+		noise_1.SetFrequency(2.0f);
+	}
+
+	// Create and initialize a noise::module::RidgedMulti. This noise module 
+	// will create round basins and sharp mountain ranges.
+
+	noise::module::RidgedMulti noise_2;
+
+	{
+		// Set the seed to the seed of the planet.
+
+		noise_2.SetSeed(planet_seed);
+
+		// Set the octave count to 16 for a high level of detail.
+
+		noise_2.SetOctaveCount(16);
+
+		// Set the frequency to 2.0f to make the noise more random and less
+		// coherent.
+
+		noise_2.SetFrequency(1.0f);
+	}
+
+	// Create a gradient to define the color of points on the planet based on 
+	// the point's elevation.
+
+	noise::utils::GradientColor color_map;
+
+	color_map.Clear();
+	
+	color_map.AddGradientPoint(0.0f - 1.0000f, noise::utils::Color(0x00, 0x00, 0x80, 0xFF));
+	color_map.AddGradientPoint(0.0f - 0.2500f, noise::utils::Color(0x00, 0x00, 0xFF, 0xFF));
+	color_map.AddGradientPoint(0.0f + 0.0000f, noise::utils::Color(0x00, 0x80, 0xFF, 0xFF));
+	color_map.AddGradientPoint(0.0f + 0.0625f, noise::utils::Color(0xF0, 0xF0, 0x40, 0xFF));
+	color_map.AddGradientPoint(0.0f + 0.1250f, noise::utils::Color(0x20, 0xA0, 0x00, 0xFF));
+	color_map.AddGradientPoint(0.0f + 0.3750f, noise::utils::Color(0xE0, 0xE0, 0x00, 0xFF));
+	color_map.AddGradientPoint(0.0f + 0.7500f, noise::utils::Color(0x80, 0x80, 0x80, 0xFF));
+	color_map.AddGradientPoint(0.0f + 1.0000f, noise::utils::Color(0xFF, 0xFF, 0xFF, 0xFF));
+
+	// Choose how the icosphere is drawn. When icosphere_indexed is true, the
+	// icosphere is kept as an indexed mesh of unique vertices with smooth 
+	// normals and drawn with glDrawElementsBaseVertex. Otherwise it is 
+	// expanded into a flat shaded triangle soup and drawn with glDrawArrays,
+	// which needs about 6 times as many vertices.
+
+	bool icosphere_indexed = true;
+
+	// Choose whether the triangle soup is streamed into the vertex buffer in
+	// batches by stream_icosphere, instead of being generated in memory 
+	// first. Only a few patches are in memory at once, so this still works 
+	// at 10 or more subdivisions. Streamed planets are not cached.
+
+	bool icosphere_streamed = false;
+
+	// Choose whether the triangles of the indexed icosphere are reordered for
+	// the post-transform vertex cache and then for overdraw.
+
+	bool icosphere_optimized = true;
+
+	// Choose whether the indexed planet's base mesh is a cube-sphere of 6 
+	// regular grids instead of an icosphere. The heights of each face are
+	// then generated as a NoiseMap. The cube-sphere has about as many 
+	// triangles as the icosphere.
+
+	bool icosphere_cube_sphere = false;
+
+	// Choose whether the indexed icosphere is only subdivided where the 
+	// terrain needs it, by create_icosphere_adaptive, instead of everywhere.
+	// Flat water then stays much coarser than land.
+
+	bool icosphere_adaptive = true;
+
+	// Choose whether the icosphere's vertices are uploaded as 12 byte 
+	// compact_vertices instead of 9 floats, and decoded by 
+	// compact_vertex.glsl.
+
+	bool icosphere_compact = true;
+
+	// Choose whether the indexed icosphere is split into meshlets of at most
+	// 64 vertices and 124 triangles instead of one chunk per face of the 
+	// icosahedron. Meshlets that face away from the camera are not drawn.
+
+	bool icosphere_meshlets = true;
+
+	// Choose whether the planet is drawn by a planet_lod, whose level of 
+	// detail follows the camera, instead of as one icosphere with a fixed 
+	// amount of subdivisions.
+
+	bool icosphere_lod = true;
+
+	// Choose whether the planet is drawn by a roam_planet instead, which 
+	// keeps the amount of triangles at a fixed budget. Takes precedence over
+	// icosphere_lod.
+
+	bool icosphere_roam = false;
+
+	// Choose whether the ocean is drawn as an exact sphere by 
+	// ocean_fragment.glsl. The terrain then leaves out the triangles (or 
+	// patches of the planet_lod) that lie entirely at sea level. The 
+	// roam_planet keeps its own flat water, which the ocean hides.
+
+	bool icosphere_ocean = true;
+
+	// The amount of vertices in the icosphere's vertex buffer, and the chunks
+	// of the icosphere's element buffer when icosphere_indexed is true.
+
+	size_t icosphere_vertex_count = 0;
+
+	chunked_mesh icosphere_chunks;
+
+	// The vertex data of the icosphere.
+
+	float* icosphere_vertices = NULL;
+
+	// The vertex data of the icosphere in the format it is uploaded in. It 
+	// points at icosphere_vertices, at icosphere_compact_vertices or into the
+	// cache file.
+
+	const void* icosphere_vertex_data = NULL;
+
+	std::vector<compact_vertex> icosphere_compact_vertices;
+
+	// The bounds of the icosphere's meshlets.
+
+	std::vector<meshlet_bounds> icosphere_meshlet_bounds;
+
+	// Meshlets are only made for the indexed icosphere.
+
+	icosphere_meshlets = icosphere_meshlets && icosphere_indexed && !icosphere_lod && !icosphere_roam;
+
+	// Only the indexed icosphere can be adaptive.
+
+	icosphere_adaptive = icosphere_adaptive && icosphere_indexed && !icosphere_cube_sphere;
+
+	// Only the triangle soup can be streamed.
+
+	icosphere_streamed = icosphere_streamed && !icosphere_indexed && !icosphere_lod && !icosphere_roam;
+
+	// The planet_lod and the roam_planet use their own vertex format.
+
+	icosphere_compact = icosphere_compact && !icosphere_lod && !icosphere_roam;
+
+	size_t icosphere_vertex_size = icosphere_compact ? sizeof(compact_vertex) : 9 * sizeof(float);
+
+	// Try to load the planet from its cache file. When the cache is used, 
+	// icosphere_vertex_data points into icosphere_cache_file.
+
+	planet_cache_key icosphere_cache_key = get_planet_cache_key(icosphere_subdivisions, icosphere_indexed, icosphere_optimized, icosphere_meshlets, icosphere_compact, icosphere_cube_sphere && icosphere_indexed, icosphere_adaptive, icosphere_ocean, planet_seed, noise_1, noise_2, color_map);
+
+	mapped_file icosphere_cache_file = {NULL, 0};
+
+	bool icosphere_cached = planet_seeded && !icosphere_lod && !icosphere_roam && !icosphere_streamed && load_planet_cache(icosphere_cache_key, icosphere_vertex_size, icosphere_cache_file, icosphere_vertex_data, icosphere_vertex_count, icosphere_chunks, icosphere_meshlet_bounds);
+
+	if (icosphere_lod || icosphere_roam)
+	{
+		// The planet_lod and the roam_planet generate their own triangles,
+		// there is no icosphere.
+	}
+	else if (icosphere_cached)
+	{
+		if (planet_verbose)
+		{
+			std::cout << "Loaded the planet from " << get_planet_cache_path(icosphere_cache_key) << "." << std::endl;
+		}
+	}
+	else if (icosphere_streamed)
+	{
+		// The triangle soup is streamed into the VBO once it exists.
+
+		icosphere_vertex_count = (size_t(20) << (icosphere_subdivisions * 2)) * 3;
+	}
+	else if (icosphere_indexed)
+	{
+		// Generate the base icosphere.
+
+		indexed_mesh icosphere_mesh;
+
+		std::vector<float> noise_map;
+
+		if (icosphere_cube_sphere)
+		{
+			// Generate a cube-sphere, and the noise values of each of its 
+			// faces as one NoiseMap tile.
+
+			cube_sphere_mesh cube_sphere = create_cube_sphere(int((1 << icosphere_subdivisions) * std::sqrt(5.0f / 3.0f)));
+
+			icosphere_mesh.vertices.swap(cube_sphere.mesh.vertices);
+			icosphere_mesh.indices.swap(cube_sphere.mesh.indices);
+
+			noise_map.resize(icosphere_mesh.vertices.size());
+
+			int row = cube_sphere.segments + 1;
+
+			noise::utils::NoiseMap face_noise_map;
+
+			for (int face = 0; face < 6; face++)
+			{
+				build_cube_sphere_noise_map(face_noise_map, noise_1, noise_2, face, cube_sphere.segments, 0, 0, row, row);
+
+				for (int y = 0; y < row; y++)
+				{
+					const float* noise_row = face_noise_map.GetConstSlabPtr(y);
+
+					for (int x = 0; x < row; x++)
+					{
+						noise_map[cube_sphere.grid_vertices[(face * row + y) * row + x]] = noise_row[x];
+					}
+				}
+			}
+		}
+		else if (icosphere_adaptive)
+		{
+			// Generate the adaptive icosphere, which finds the noise value of
+			// each unique vertex on the way.
+
+			icosphere_mesh = create_icosphere_adaptive(icosphere_subdivisions, noise_1, noise_2, noise_map);
+
+			if (planet_verbose)
+			{
+				std::cout << "Generated an adaptive icosphere with " << icosphere_mesh.indices.size() / 3 << " triangles, instead of " << (size_t(20) << (icosphere_subdivisions * 2)) << "." << std::endl;
+			}
+		}
+		else
+		{
+			// Generate the icosphere, and the noise value of each unique 
+			// vertex.
+
+			icosphere_mesh = create_icosphere_fixed<icosphere_subdivisions>();
+
+			noise_map.resize(icosphere_mesh.vertices.size());
+
+			get_terrain_noise_values(noise_1, noise_2, &icosphere_mesh.vertices[0], &noise_map[0], icosphere_mesh.vertices.size());
+		}
+
+		// Perturb the terrain by the noise values.
+
+		get_thread_pool().parallel_for(icosphere_mesh.vertices.size(), 4096, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				icosphere_mesh.vertices[i] = get_terrain_position(icosphere_mesh.vertices[i], noise_map[i]);
+			}
+		});
+
+		// The triangles of each face of the base mesh are contiguous. They
+		// are split into face_count ranges of (about) the same size, which 
+		// follow the faces exactly unless the icosphere is adaptive. Range i
+		// ends before triangle face_ends[i].
+
+		size_t face_count = icosphere_cube_sphere ? 6 : 20;
+
+		size_t face_triangle_count = (icosphere_mesh.indices.size() / 3 + face_count - 1) / face_count;
+
+		std::vector<size_t> face_ends(face_count);
+
+		for (size_t i = 0; i < face_count; i++)
+		{
+			face_ends[i] = std::min((i + 1) * face_triangle_count, icosphere_mesh.indices.size() / 3);
+		}
+
+		// Calculate the smooth normal of each vertex.
+
+		std::vector<glm::vec3> normals = get_smooth_normals(icosphere_mesh);
+
+		// Leave out the triangles that lie entirely at sea level, which the
+		// ocean covers. This happens after the normals are found, so that 
+		// the normals at the coast do not change. Each range is compacted 
+		// in place and keeps its own end, so that the ranges still follow 
+		// the faces. Vertices that are no longer used are left out of the 
+		// chunks below.
+
+		if (icosphere_ocean)
+		{
+			size_t kept = 0;
+
+			size_t first = 0;
+
+			for (size_t i = 0; i < face_count; i++)
+			{
+				for (size_t j = first * 3; j < face_ends[i] * 3; j += 3)
+				{
+					const unsigned int* triangle = &icosphere_mesh.indices[j];
+
+					if (noise_map[triangle[0]] > 0.0f || noise_map[triangle[1]] > 0.0f || noise_map[triangle[2]] > 0.0f)
+					{
+						std::copy(triangle, triangle + 3, &icosphere_mesh.indices[kept]);
+
+						kept += 3;
+					}
+				}
+
+				first = face_ends[i];
+
+				face_ends[i] = kept / 3;
+			}
+
+			if (planet_verbose)
+			{
+				std::cout << "Left out " << (icosphere_mesh.indices.size() - kept) / 3 << " of " << icosphere_mesh.indices.size() / 3 << " triangles under the ocean." << std::endl;
+			}
+
+			icosphere_mesh.indices.resize(kept);
+		}
+
+		// Reorder the triangles of each face of the base mesh for the vertex
+		// cache and then for overdraw. The faces stay contiguous, so that 
+		// each one still becomes one chunk below.
+
+		if (icosphere_optimized)
+		{
+			float acmr_before = planet_verbose ? get_acmr(&icosphere_mesh.indices[0], icosphere_mesh.indices.size(), icosphere_mesh.vertices.size()) : 0.0f;
+
+			get_thread_pool().parallel_for(face_count, 1, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					size_t face_first = i > 0 ? face_ends[i - 1] * 3 : 0;
+
+					size_t face_index_count = face_ends[i] * 3 - face_first;
+
+					unsigned int* face_indices = &icosphere_mesh.indices[0] + face_first;
+
+					optimize_triangle_order(face_indices, face_index_count, &icosphere_mesh.vertices[0]);
+				}
+			});
+
+			if (planet_verbose)
+			{
+				float acmr_after = get_acmr(&icosphere_mesh.indices[0], icosphere_mesh.indices.size(), icosphere_mesh.vertices.size());
+
+				std::cout << "Optimized the icosphere's triangle order, ACMR " << acmr_before << " -> " << acmr_after << "." << std::endl;
+			}
+		}
+
+		// Split the icosphere into meshlets, or into one chunk per face of 
+		// the base mesh.
+
+		if (icosphere_meshlets)
+		{
+			icosphere_chunks = create_meshlets(icosphere_mesh, 64, 124, face_ends);
+		}
+		else
+		{
+			icosphere_chunks = create_mesh_chunks(icosphere_mesh, face_ends);
+		}
+
+		icosphere_vertex_count = icosphere_chunks.vertex_sources.size();
+
+		// Allocate space to hold the vertex data of the icosphere.
+
+		icosphere_vertices = (float*)malloc(icosphere_vertex_count * (9 * sizeof(float)));
+
+		// Generate the vertex data, in parallel blocks of 1024 vertices.
+
+		get_thread_pool().parallel_for(icosphere_vertex_count, 1024, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				unsigned int source = icosphere_chunks.vertex_sources[i];
+
+				utils::Color color = color_map.GetColor(noise_map[source]);
+
+				glm::vec3 normal = normals[source];
+
+				// Write the position of the current vertex.
+
+				icosphere_vertices[i * 9 + 0] = icosphere_mesh.vertices[source].x;
+				icosphere_vertices[i * 9 + 1] = icosphere_mesh.vertices[source].y;
+				icosphere_vertices[i * 9 + 2] = icosphere_mesh.vertices[source].z;
+
+				// Write the color of the current vertex.
+
+				icosphere_vertices[i * 9 + 3] = color.red / 255.0f;
+
+				icosphere_vertices[i * 9 + 4] = color.green / 255.0f;
+
+				icosphere_vertices[i * 9 + 5] = color.blue / 255.0f;
+
+				// Write the surface normal of the current vertex.
+
+				icosphere_vertices[i * 9 + 6] = normal.x;
+				icosphere_vertices[i * 9 + 7] = normal.y;
+				icosphere_vertices[i * 9 + 8] = normal.z;
+			}
+		});
+	}
+	else
+	{
+		// Generate the base icosphere as an indexed mesh, so that the noise
+		// value and color of every unique vertex is only found once instead 
+		// of once for each of the (about 6) triangles around it.
+
+		indexed_mesh icosphere_base_mesh = create_icosphere_parallel(icosphere_subdivisions);
+
+		icosphere_vertex_count = icosphere_base_mesh.indices.size();
+
+		// Allocate space to hold the vertex data of the icosphere.
+
+		icosphere_vertices = (float*)malloc(icosphere_vertex_count * (9 * sizeof(float)));
+
+		// The rest is done in parallel, in blocks of 1024 unique vertices or
+		// 1024 triangles (about 110 KB of vertex data). Every block writes 
+		// only its own part of the output, so the output does not depend on
+		// the amount of threads.
+
+		const size_t block_size = 1024;
+
+		// Perturb the terrain using the noise modules, and find the color of
+		// each unique vertex.
+
+		size_t unique_vertex_count = icosphere_base_mesh.vertices.size();
+
+		std::vector<float> noise_map(unique_vertex_count);
+
+		std::vector<utils::Color> colors(unique_vertex_count);
+
+		get_thread_pool().parallel_for(unique_vertex_count, block_size, [&](size_t begin, size_t end)
+		{
+			get_terrain_noise_values(noise_1, noise_2, &icosphere_base_mesh.vertices[begin], &noise_map[begin], end - begin);
+
+			for (size_t i = begin; i < end; i++)
+			{
+				glm::vec3& vertex = icosphere_base_mesh.vertices[i];
+
+				colors[i] = color_map.GetColor(noise_map[i]);
+
+				// Perturb the current vertex by the noise value, which is 
+				// clamped to create smooth, flat water.
+
+				vertex = get_terrain_position(vertex, noise_map[i]);
+			}
+		});
+
+		// Triangles that lie entirely at sea level are left out when the 
+		// ocean is drawn.
+
+		auto is_triangle_kept = [&](size_t triangle_index) -> bool
+		{
+			const unsigned int* triangle = &icosphere_base_mesh.indices[triangle_index * 3];
+
+			return !icosphere_ocean || noise_map[triangle[0]] > 0.0f || noise_map[triangle[1]] > 0.0f || noise_map[triangle[2]] > 0.0f;
+		};
+
+		// Count the vertices that each block of triangles keeps, and sum 
+		// them to find where each block's vertices start.
+
+		size_t triangle_count = icosphere_base_mesh.indices.size() / 3;
+
+		size_t block_count = (triangle_count + block_size - 1) / block_size;
+
+		std::vector<size_t> block_offsets(block_count + 1, 0);
+
+		get_thread_pool().parallel_for(triangle_count, block_size, [&](size_t begin, size_t end)
+		{
+			size_t kept = 0;
+
+			for (size_t i = begin; i < end; i++)
+			{
+				kept += is_triangle_kept(i) ? 3 : 0;
+			}
+
+			block_offsets[begin / block_size + 1] = kept;
+		});
+
+		for (size_t i = 0; i < block_count; i++)
+		{
+			block_offsets[i + 1] += block_offsets[i];
+		}
+
+		// Scatter the unique vertices back to the triangles. This is done 
+		// triangle by triangle to make it easy to calculate triangle 
+		// normals.
+
+		get_thread_pool().parallel_for(triangle_count, block_size, [&](size_t begin, size_t end)
+		{
+			size_t soup_vertex_count = block_offsets[begin / block_size];
+
+			for (size_t i = begin; i < end; i++)
+			{
+				if (!is_triangle_kept(i))
+				{
+					continue;
+				}
+
+				const unsigned int* triangle = &icosphere_base_mesh.indices[i * 3];
 
-		std::cout << crash_information_program;
+				// Calculate the triangle's normal.
 
-		exit(EXIT_FAILURE);
-	}
+				glm::vec3 edge_1 = icosphere_base_mesh.vertices[triangle[1]] - icosphere_base_mesh.vertices[triangle[0]];
+				glm::vec3 edge_2 = icosphere_base_mesh.vertices[triangle[2]] - icosphere_base_mesh.vertices[triangle[0]];
 
-	// Delete shader_0 and shader_1, then return shader_program.
+				glm::vec3 normal = glm::normalize(glm::cross(edge_1, edge_2));
 
-	glDeleteShader(shader_0);
-	glDeleteShader(shader_1);
+				float nx = normal.x;
+				float ny = normal.y;
+				float nz = normal.z;
 
-	return shader_program;
-}
+				// Generate the vertex data.
 
-/*
+				for (int j = 0; j < 3; j++)
+				{
+					glm::vec3 position = icosphere_base_mesh.vertices[triangle[j]];
 
-Entry point.
+					utils::Color color = colors[triangle[j]];
 
-*/
+					// Write the position of the current vertex.
 
-int main(int argc, char** argv)
-{
-	// Initialize SDL.
+					icosphere_vertices[(soup_vertex_count + j) * 9 + 0] = position.x;
+					icosphere_vertices[(soup_vertex_count + j) * 9 + 1] = position.y;
+					icosphere_vertices[(soup_vertex_count + j) * 9 + 2] = position.z;
 
-	if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
-	{
-		std::cout << "Could not initialize SDL." << std::endl;
+					// Write the color of the current vertex.
 
-		return EXIT_FAILURE;
-	}
+					icosphere_vertices[(soup_vertex_count + j) * 9 + 3] = color.red / 255.0f;
 
-	// Create a SDL_Window*.
+					icosphere_vertices[(soup_vertex_count + j) * 9 + 4] = color.green / 255.0f;
 
-	int sdl_x_res = 960;
-	int sdl_y_res = 960;
+					icosphere_vertices[(soup_vertex_count + j) * 9 + 5] = color.blue / 255.0f;
 
-	SDL_Window* sdl_window = SDL_CreateWindow
-	(
-		"SDL 2.0 with OpenGL 3.3 Core",
+					// Write the surface normal of the current vertex.
 
-		SDL_WINDOWPOS_UNDEFINED,
-		SDL_WINDOWPOS_UNDEFINED,
+					icosphere_vertices[(soup_vertex_count + j) * 9 + 6] = nx;
+					icosphere_vertices[(soup_vertex_count + j) * 9 + 7] = ny;
+					icosphere_vertices[(soup_vertex_count + j) * 9 + 8] = nz;
+				}
 
-		sdl_x_res,
-		sdl_y_res,
+				soup_vertex_count += 3;
+			}
+		});
 
-		SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL
-	);
+		icosphere_vertex_count = block_offsets[block_count];
+	}
 
-	// Make sure the SDL_Window* was created successfully.
+	// Find the bounds of the icosphere's meshlets, and quantise its vertices
+	// to compact_vertices if icosphere_compact is true, so that both can be
+	// cached. A streamed icosphere is quantised one batch at a time instead.
 
-	if (!sdl_window)
+	if (!icosphere_lod && !icosphere_roam && !icosphere_streamed && !icosphere_cached)
 	{
-		std::cout << "Could not create a SDL_Window*." << std::endl;
-
-		return EXIT_FAILURE;
-	}
+		if (icosphere_meshlets)
+		{
+			icosphere_meshlet_bounds = get_meshlet_bounds(icosphere_chunks, icosphere_vertices);
+		}
 
-	// Request OpenGL 3.3 Core.
+		if (icosphere_compact)
+		{
+			icosphere_compact_vertices = create_compact_vertices(icosphere_vertices, icosphere_vertex_count);
 
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+			icosphere_vertex_data = icosphere_compact_vertices.empty() ? NULL : &icosphere_compact_vertices[0];
+		}
+		else
+		{
+			icosphere_vertex_data = icosphere_vertices;
+		}
+	}
 
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	// Save the planet to its cache file, so that the next launch with the 
+	// same seed can skip generating it.
 
-	// Create a SDL_GLContext.
+	if (planet_seeded && !icosphere_lod && !icosphere_roam && !icosphere_streamed && !icosphere_cached)
+	{
+		if (!save_planet_cache(icosphere_cache_key, icosphere_vertex_data, icosphere_vertex_size, icosphere_vertex_count, icosphere_chunks, icosphere_meshlet_bounds))
+		{
+			std::cout << "Could not save the planet to " << get_planet_cache_path(icosphere_cache_key) << "." << std::endl;
+		}
+	}
 
-	SDL_GLContext gl_context = SDL_GL_CreateContext(sdl_window);
+	// Generate a VAO, a VBO and an EBO for the icosphere. The planet_lod and
+	// the roam_planet have their own, so the icosphere's stay 0 (which 
+	// glDelete* ignores) when either is used.
 
-	// Make sure the SDL_GLContext was created successfully.
+	GLuint icosphere_vao = 0;
+	GLuint icosphere_vbo = 0;
+	GLuint icosphere_ebo = 0;
 
-	if (!gl_context)
+	if (!icosphere_lod && !icosphere_roam)
 	{
-		std::cout << "Could not create a SDL_GLContext." << std::endl;
+		glGenVertexArrays(1, &icosphere_vao);
 
-		return EXIT_FAILURE;
-	}
+		glGenBuffers(1, &icosphere_vbo);
+		glGenBuffers(1, &icosphere_ebo);
 
-	// Load all OpenGL 3.3 Core functions using GLAD.
+		// Bind the VAO and the VBO of the icosphere to the current state.
 
-	if (!gladLoadGLLoader(SDL_GL_GetProcAddress)) 
-	{
-		std::cout << "Could not load OpenGL 3.3 Core functions using GLAD." << std::endl;
+		glBindVertexArray(icosphere_vao);
 
-		return EXIT_FAILURE;
-	}
+		glBindBuffer(GL_ARRAY_BUFFER, icosphere_vbo);
 
-	// Make sure the OpenGL version that was loaded by GLAD is greater than or
-	// equal to OpenGL 3.3.
+		// Upload the icosphere data to the VBO. A streamed icosphere is 
+		// generated and uploaded one batch at a time.
 
-	if (GLVersion.major * 10 + GLVersion.minor < 33)
-	{
-		std::cout << "Could not load OpenGL 3.3 Core functions using GLAD." << std::endl;
+		if (icosphere_streamed)
+		{
+			glBufferData(GL_ARRAY_BUFFER, icosphere_vertex_count * icosphere_vertex_size, NULL, GL_STATIC_DRAW);
 
-		return EXIT_FAILURE;
-	}
+			size_t streamed_vertex_count = 0;
 
-	// Create and initialize a noise::module::Perlin. This noise module will
-	// dictate the general shape of the islands on the planet.
+			stream_icosphere(icosphere_subdivisions, noise_1, noise_2, color_map, [&](const float* vertices, size_t vertex_count)
+			{
+				if (icosphere_compact)
+				{
+					std::vector<compact_vertex> compact_vertices = create_compact_vertices(vertices, vertex_count);
 
-	noise::module::Perlin noise_1;
+					glBufferSubData(GL_ARRAY_BUFFER, streamed_vertex_count * icosphere_vertex_size, vertex_count * icosphere_vertex_size, &compact_vertices[0]);
+				}
+				else
+				{
+					glBufferSubData(GL_ARRAY_BUFFER, streamed_vertex_count * icosphere_vertex_size, vertex_count * icosphere_vertex_size, vertices);
+				}
 
-	{
-		// Set the seed to the current time, so that the output noise will be
-		// slightly different every time.
+				streamed_vertex_count += vertex_count;
+			}, icosphere_ocean);
 
-		noise_1.SetSeed(time(NULL));
+			icosphere_vertex_count = streamed_vertex_count;
+		}
+		else
+		{
+			glBufferData(GL_ARRAY_BUFFER, icosphere_vertex_count * icosphere_vertex_size, icosphere_vertex_data, GL_STATIC_DRAW);
 
-		// Set the octave count to 16 for a high level of detail.
+			// The compact_vertices are not needed once they are uploaded.
 
-		noise_1.SetOctaveCount(16);
+			std::vector<compact_vertex>().swap(icosphere_compact_vertices);
+		}
 
-		// Set the frequency to 2.0f to make the noise more random and less
-		// coherent.
+		// Upload the icosphere's indices to the EBO. The EBO binding is stored
+		// in the VAO, so it must stay bound until the VAO is unbound.
 
-		noise_1.SetFrequency(2.0f);
-	}
+		if (icosphere_indexed)
+		{
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, icosphere_ebo);
 
-	// Create and initialize a noise::module::RidgedMulti. This noise module 
-	// will create round basins and sharp mountain ranges.
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, icosphere_chunks.index_data.size(), icosphere_chunks.index_data.empty() ? NULL : &icosphere_chunks.index_data[0], GL_STATIC_DRAW);
+		}
 
-	noise::module::RidgedMulti noise_2;
+		// Enable the required vertex attribute pointers. The signed integers of
+		// a compact_vertex are not normalized by OpenGL, because OpenGL 3.3 can
+		// not represent 0 exactly when it normalizes signed integers. 
+		// compact_vertex.glsl divides them instead.
 
-	{
-		// Set the seed to the current time, so that the output noise will be
-		// slightly different every time.
+		if (icosphere_compact)
+		{
+			glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(compact_vertex), (void*)offsetof(compact_vertex, direction));
+			glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(compact_vertex), (void*)offsetof(compact_vertex, color));
+			glVertexAttribPointer(2, 2, GL_BYTE, GL_FALSE, sizeof(compact_vertex), (void*)offsetof(compact_vertex, normal));
+			glVertexAttribPointer(3, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(compact_vertex), (void*)offsetof(compact_vertex, height));
 
-		noise_2.SetSeed(time(NULL));
+			glEnableVertexAttribArray(3);
+		}
+		else
+		{
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(0 * sizeof(float)));
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(3 * sizeof(float)));
+			glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(6 * sizeof(float)));
+		}
 
-		// Set the octave count to 16 for a high level of detail.
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(2);
 
-		noise_2.SetOctaveCount(16);
+		// Unbind the VAO and the VBO of the icosphere from the current state.
 
-		// Set the frequency to 2.0f to make the noise more random and less
-		// coherent.
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-		noise_2.SetFrequency(1.0f);
+		glBindVertexArray(0);
 	}
 
-	// Create a gradient to define the color of points on the planet based on 
-	// the point's elevation.
-
-	noise::utils::GradientColor color_map;
+	// Allocate the lists of meshlets that are drawn each frame.
 
-	color_map.Clear();
-	
-	color_map.AddGradientPoint(0.0f - 1.0000f, noise::utils::Color(0x00, 0x00, 0x80, 0xFF));
-	color_map.AddGradientPoint(0.0f - 0.2500f, noise::utils::Color(0x00, 0x00, 0xFF, 0xFF));
-	color_map.AddGradientPoint(0.0f + 0.0000f, noise::utils::Color(0x00, 0x80, 0xFF, 0xFF));
-	color_map.AddGradientPoint(0.0f + 0.0625f, noise::utils::Color(0xF0, 0xF0, 0x40, 0xFF));
-	color_map.AddGradientPoint(0.0f + 0.1250f, noise::utils::Color(0x20, 0xA0, 0x00, 0xFF));
-	color_map.AddGradientPoint(0.0f + 0.3750f, noise::utils::Color(0xE0, 0xE0, 0x00, 0xFF));
-	color_map.AddGradientPoint(0.0f + 0.7500f, noise::utils::Color(0x80, 0x80, 0x80, 0xFF));
-	color_map.AddGradientPoint(0.0f + 1.0000f, noise::utils::Color(0xFF, 0xFF, 0xFF, 0xFF));
+	std::vector<GLsizei> meshlet_index_counts;
 
-	// Generate the base icosphere.
+	std::vector<const void*> meshlet_index_offsets;
 
-	std::vector<glm::vec3> icosphere_managed_vertices = create_icosphere(8);
+	std::vector<GLint> meshlet_base_vertices;
 
-	// Allocate space to hold the vertex data of the icosphere.
+	// The amount of meshlets that were culled in the last frame.
 
-	float* icosphere_vertices = (float*)malloc(icosphere_managed_vertices.size() * (9 * sizeof(float)));
+	size_t backfacing_meshlet_count = 0;
 
-	// Perturb the terrain using the noise modules by iterating through each 
-	// triangle rather than each vertex. This is done to make it easy to 
-	// calculate triangle normals.
+	size_t frustum_culled_meshlet_count = 0;
 
-	for (int i = 0; i < icosphere_managed_vertices.size(); i += 3)
-	{
-		// Create an array to hold the noise values at the three vertices of 
-		// the current triangle.
+	// Create the planet_lod or the roam_planet. They generate their roots 
+	// right away.
 
-		float noise_map[3];
+	planet_lod* icosphere_planet_lod = NULL;
 
-		for (int j = 0; j < 3; j++)
-		{
-			// Get the current vertex.
+	roam_planet* icosphere_roam_planet = NULL;
 
-			glm::vec3 vertex = icosphere_managed_vertices[i + j];
+	if (icosphere_roam)
+	{
+		icosphere_roam_planet = new roam_planet(noise_1, noise_2, color_map);
+	}
+	else if (icosphere_lod)
+	{
+		icosphere_planet_lod = new planet_lod(noise_1, noise_2, color_map, icosphere_ocean);
+	}
 
-			// Get the noise value at the current vertex.
+	// Load the default shader program.
 
-			float actual_noise_value = noise_1.GetValue(vertex.x, vertex.y, vertex.z) * (noise_2.GetValue(vertex.x, vertex.y, vertex.z) + 0.2f);
+	GLuint default_shader_program = load_shader_program("default_vertex.glsl", "default_fragment.glsl", GL_VERTEX_SHADER, GL_FRAGMENT_SHADER);
 
-			// Clamp the noise value to create smooth, flat water.
+	// Load the shader program that decodes compact_vertices, if the 
+	// icosphere is drawn with them. Otherwise the icosphere is drawn with the
+	// default shader program.
 
-			float noise_value = std::max(0.0f, actual_noise_value);
+	GLuint icosphere_shader_program = default_shader_program;
 
-			noise_map[j] = actual_noise_value;
+	if (icosphere_compact)
+	{
+		icosphere_shader_program = load_shader_program("compact_vertex.glsl", "default_fragment.glsl", GL_VERTEX_SHADER, GL_FRAGMENT_SHADER);
 
-			// Perturb the current vertex by the noise value.
+		glUseProgram(icosphere_shader_program);
 
-			icosphere_managed_vertices[i + j] = vertex * (1.0f + noise_value * 0.075f);
-		}
+		glUniform1f(glGetUniformLocation(icosphere_shader_program, "height_range"), compact_height_range);
 
-		// Calculate the triangle's normal.
+		glUseProgram(0);
+	}
 
-		glm::vec3 edge_1 = icosphere_managed_vertices[i + 1] - icosphere_managed_vertices[i];
-		glm::vec3 edge_2 = icosphere_managed_vertices[i + 2] - icosphere_managed_vertices[i];
+	// Create the ocean. It is drawn as the back faces of a cube around the 
+	// unit sphere, which cover every ray from the camera that hits the 
+	// sphere, and ocean_fragment.glsl intersects those rays with the sphere.
+	// Its colors are looked up in a texture.
 
-		glm::vec3 normal = glm::normalize(glm::cross(edge_1, edge_2));
+	GLuint ocean_shader_program = 0;
 
-		float nx = normal.x;
-		float ny = normal.y;
-		float nz = normal.z;
-		
-		// Generate the vertex data.
+	GLuint ocean_vao = 0;
+	GLuint ocean_vbo = 0;
+	GLuint ocean_ebo = 0;
 
-		for (int j = 0; j < 3; j++)
-		{
-			utils::Color color = color_map.GetColor(noise_map[j]);
+	GLuint ocean_texture = 0;
 
-			// Write the position of the current vertex.
+	if (icosphere_ocean)
+	{
+		ocean_shader_program = load_shader_program("ocean_vertex.glsl", "ocean_fragment.glsl", GL_VERTEX_SHADER, GL_FRAGMENT_SHADER);
 
-			icosphere_vertices[(i + j) * 9 + 0] = icosphere_managed_vertices[i + j].x;
-			icosphere_vertices[(i + j) * 9 + 1] = icosphere_managed_vertices[i + j].y;
-			icosphere_vertices[(i + j) * 9 + 2] = icosphere_managed_vertices[i + j].z;
+		const float cube_vertices[8 * 3] =
+		{
+			-1.0f, -1.0f, -1.0f,
+			+1.0f, -1.0f, -1.0f,
+			-1.0f, +1.0f, -1.0f,
+			+1.0f, +1.0f, -1.0f,
+			-1.0f, -1.0f, +1.0f,
+			+1.0f, -1.0f, +1.0f,
+			-1.0f, +1.0f, +1.0f,
+			+1.0f, +1.0f, +1.0f
+		};
+
+		// The faces of the cube, wound counter-clockwise as seen from 
+		// outside.
+
+		const unsigned char cube_indices[12 * 3] =
+		{
+			0, 2, 1, 1, 2, 3,
+			4, 5, 6, 5, 7, 6,
+			0, 1, 4, 1, 5, 4,
+			2, 6, 3, 3, 6, 7,
+			0, 4, 2, 2, 4, 6,
+			1, 3, 5, 3, 7, 5
+		};
 
-			// Write the color of the current vertex.
+		glGenVertexArrays(1, &ocean_vao);
 
-			icosphere_vertices[(i + j) * 9 + 3] = color.red / 255.0f;
+		glGenBuffers(1, &ocean_vbo);
+		glGenBuffers(1, &ocean_ebo);
 
-			icosphere_vertices[(i + j) * 9 + 4] = color.green / 255.0f;
+		glBindVertexArray(ocean_vao);
 
-			icosphere_vertices[(i + j) * 9 + 5] = color.blue / 255.0f;
+		glBindBuffer(GL_ARRAY_BUFFER, ocean_vbo);
 
-			// Write the surface normal of the current vertex.
+		glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
 
-			icosphere_vertices[(i + j) * 9 + 6] = nx;
-			icosphere_vertices[(i + j) * 9 + 7] = ny;
-			icosphere_vertices[(i + j) * 9 + 8] = nz;
-		}
-	}
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ocean_ebo);
 
-	// Generate a VAO and a VBO for the icosphere.
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
 
-	GLuint icosphere_vao;
-	GLuint icosphere_vbo;
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-	glGenVertexArrays(1, &icosphere_vao);
+		glEnableVertexAttribArray(0);
 
-	glGenBuffers(1, &icosphere_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	// Bind the VAO and the VBO of the icosphere to the current state.
+		glBindVertexArray(0);
 
-	glBindVertexArray(icosphere_vao);
+		// Upload the ocean's colors. The texture wraps around in longitude.
 
-	glBindBuffer(GL_ARRAY_BUFFER, icosphere_vbo);
+		int ocean_colors_width = 512;
+		int ocean_colors_height = 256;
 
-	// Upload the icosphere data to the VBO.
+		std::vector<uint8_t> ocean_colors = create_ocean_colors(noise_1, noise_2, color_map, ocean_colors_width, ocean_colors_height);
 
-	glBufferData(GL_ARRAY_BUFFER, icosphere_managed_vertices.size() * (10 * sizeof(float)), icosphere_vertices, GL_STATIC_DRAW);
+		glGenTextures(1, &ocean_texture);
 
-	// Enable the required vertex attribute pointers.
+		glBindTexture(GL_TEXTURE_2D, ocean_texture);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(0 * sizeof(float)));
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(3 * sizeof(float)));
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)(6 * sizeof(float)));
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, ocean_colors_width, ocean_colors_height, 0, GL_RGB, GL_UNSIGNED_BYTE, &ocean_colors[0]);
 
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	// Unbind the VAO and the VBO of the icosphere from the current state.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
 
-	glBindVertexArray(0);
+		glUseProgram(ocean_shader_program);
 
-	// Load the default shader program.
+		glUniform1i(glGetUniformLocation(ocean_shader_program, "ocean_colors"), 0);
 
-	GLuint default_shader_program = load_shader_program("default_vertex.glsl", "default_fragment.glsl", GL_VERTEX_SHADER, GL_FRAGMENT_SHADER);
+		glUseProgram(0);
+	}
 
 	// Define variables to hold the state of the mouse and the application's
 	// state.
@@ -619,6 +8498,23 @@ int main(int argc, char** argv)
 
 	bool sdl_running = true;
 
+	// Define variables to hold the state of the camera. The camera looks at 
+	// the planet from camera_distance, the planet spins more slowly as the 
+	// camera gets closer to it.
+
+	float camera_distance = 2.0f;
+
+	float planet_rotation = 0.0f;
+
+	unsigned int last_ticks = SDL_GetTicks();
+
+	// Define variables to hold the time that the window's title was last 
+	// updated, and the amount of frames since then.
+
+	unsigned int title_ticks = last_ticks;
+
+	unsigned int title_frames = 0;
+
 	// Enter the main loop.
 
 	while (sdl_running)
@@ -672,6 +8568,15 @@ int main(int argc, char** argv)
 					sdl_mouse_r = false;
 				}
 			}
+			else if (e.type == SDL_MOUSEWHEEL)
+			{
+				// The mouse wheel was scrolled. Zoom towards the surface, in 
+				// steps that are proportional to the camera's altitude.
+
+				camera_distance = 1.0f + (camera_distance - 1.0f) * std::pow(0.9f, (float)e.wheel.y);
+
+				camera_distance = std::max(std::min(camera_distance, 16.0f), 1.0f + 1e-5f);
+			}
 			else if (e.type == SDL_KEYDOWN)
 			{
 				// A key was pressed.
@@ -687,6 +8592,14 @@ int main(int argc, char** argv)
 			}
 		}
 
+		// Spin the planet.
+
+		unsigned int ticks = SDL_GetTicks();
+
+		planet_rotation += (ticks - last_ticks) / 100.0f * std::min(camera_distance - 1.0f, 1.0f);
+
+		last_ticks = ticks;
+
 		// Clear the screen to black.
 
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -694,9 +8607,9 @@ int main(int argc, char** argv)
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		{
-			// Enable the default shader program.
+			// Enable the icosphere's shader program.
 
-			glUseProgram(default_shader_program);
+			glUseProgram(icosphere_shader_program);
 
 			// Enable depth testing.
 
@@ -713,7 +8626,12 @@ int main(int argc, char** argv)
 
 				// Calculate the projection matrix.
 
-				glm::mat4 matrix_projection = glm::perspective(glm::radians(70.0f), aspect_ratio, 0.128f, 1024.0f);
+				// Move the near plane closer as the camera gets closer to the
+				// surface.
+
+				float near_plane = std::max(std::min((camera_distance - 1.1f) * 0.5f, 0.128f), 1e-5f);
+
+				glm::mat4 matrix_projection = glm::perspective(glm::radians(70.0f), aspect_ratio, near_plane, 1024.0f);
 
 				// Calculate the view matrix.
 
@@ -730,21 +8648,97 @@ int main(int argc, char** argv)
 
 				// Translate the model matrix.
 
-				matrix_model = glm::translate(matrix_model, glm::vec3(0.0f, 0.0f, 0.2f * -10.0f));
+				matrix_model = glm::translate(matrix_model, glm::vec3(0.0f, 0.0f, -camera_distance));
 
 				// Rotate the model matrix.
 
-				matrix_model = glm::rotate(matrix_model, glm::radians(SDL_GetTicks() / 100.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-				matrix_model = glm::rotate(matrix_model, glm::radians(SDL_GetTicks() / 100.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+				matrix_model = glm::rotate(matrix_model, glm::radians(planet_rotation), glm::vec3(1.0f, 0.0f, 0.0f));
+				matrix_model = glm::rotate(matrix_model, glm::radians(planet_rotation), glm::vec3(0.0f, 1.0f, 0.0f));
 
 				// Pass matrix_projection, matrix_view and matrix_model to the
-				// default_shader_program.
+				// icosphere_shader_program.
+
+				glUniformMatrix4fv(glGetUniformLocation(icosphere_shader_program, "matrix_projection"), 1, GL_FALSE, &matrix_projection[0][0]);
+
+				glUniformMatrix4fv(glGetUniformLocation(icosphere_shader_program, "matrix_view"), 1, GL_FALSE, &matrix_view[0][0]);
+
+				glUniformMatrix4fv(glGetUniformLocation(icosphere_shader_program, "matrix_model"), 1, GL_FALSE, &matrix_model[0][0]);
+
+				// Choose the patches of the planet_lod to draw, or refine the
+				// roam_planet. The camera is moved into the planet's model 
+				// space, and patches are split until their vertices are at 
+				// most 6 pixels apart.
+
+				glm::vec3 camera_position = glm::vec3(glm::inverse(matrix_view * matrix_model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+				float pixel_scale = sdl_y_res / (2.0f * std::tan(glm::radians(70.0f) / 2.0f));
+
+				view_frustum frustum = get_view_frustum(matrix_projection * matrix_view * matrix_model);
+
+				// Pass the matrices and the camera's position to the 
+				// ocean_shader_program.
+
+				if (icosphere_ocean)
+				{
+					glUseProgram(ocean_shader_program);
+
+					glUniformMatrix4fv(glGetUniformLocation(ocean_shader_program, "matrix_projection"), 1, GL_FALSE, &matrix_projection[0][0]);
+
+					glUniformMatrix4fv(glGetUniformLocation(ocean_shader_program, "matrix_view"), 1, GL_FALSE, &matrix_view[0][0]);
+
+					glUniformMatrix4fv(glGetUniformLocation(ocean_shader_program, "matrix_model"), 1, GL_FALSE, &matrix_model[0][0]);
+
+					glUniform3f(glGetUniformLocation(ocean_shader_program, "camera_position"), camera_position.x, camera_position.y, camera_position.z);
+
+					glUseProgram(icosphere_shader_program);
+				}
+
+				if (icosphere_roam)
+				{
+					icosphere_roam_planet->update(camera_position, pixel_scale);
+				}
+				else if (icosphere_lod)
+				{
+					icosphere_planet_lod->update(camera_position, frustum, pixel_scale, 6.0f);
+				}
+
+				// Choose the icosphere's meshlets that do not face away from
+				// the camera and are not outside of the view frustum.
+
+				if (icosphere_meshlets)
+				{
+					meshlet_index_counts.clear();
+					meshlet_index_offsets.clear();
+					meshlet_base_vertices.clear();
+
+					backfacing_meshlet_count = 0;
+
+					frustum_culled_meshlet_count = 0;
+
+					for (size_t i = 0; i < icosphere_meshlet_bounds.size(); i++)
+					{
+						meshlet_bounds& bounds = icosphere_meshlet_bounds[i];
+
+						if (is_meshlet_backfacing(bounds, camera_position))
+						{
+							backfacing_meshlet_count++;
+						}
+						else if (is_outside_frustum(frustum, bounds.center, bounds.radius))
+						{
+							frustum_culled_meshlet_count++;
+						}
+						else
+						{
+							mesh_chunk& chunk = icosphere_chunks.chunks[i];
 
-				glUniformMatrix4fv(glGetUniformLocation(default_shader_program, "matrix_projection"), 1, GL_FALSE, &matrix_projection[0][0]);
+							meshlet_index_counts.push_back(chunk.index_count);
 
-				glUniformMatrix4fv(glGetUniformLocation(default_shader_program, "matrix_view"), 1, GL_FALSE, &matrix_view[0][0]);
+							meshlet_index_offsets.push_back((const void*)chunk.index_offset);
 
-				glUniformMatrix4fv(glGetUniformLocation(default_shader_program, "matrix_model"), 1, GL_FALSE, &matrix_model[0][0]);
+							meshlet_base_vertices.push_back(chunk.base_vertex);
+						}
+					}
+				}
 			}
 
 			// Bind the icosphere VAO to the current state.
@@ -758,14 +8752,66 @@ int main(int argc, char** argv)
 				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 			}
 
-			// Draw the icosphere VAO as an array of triangles.
+			// Draw the roam_planet, or the planet_lod's patches, or draw the
+			// icosphere VAO as an array of triangles, as the chosen meshlets
+			// in one call, or as one list of indexed triangles per chunk.
+
+			if (icosphere_roam)
+			{
+				icosphere_roam_planet->draw();
+			}
+			else if (icosphere_lod)
+			{
+				icosphere_planet_lod->draw(icosphere_shader_program);
+			}
+			else if (icosphere_meshlets)
+			{
+				if (!meshlet_index_counts.empty())
+				{
+					glMultiDrawElementsBaseVertex(GL_TRIANGLES, &meshlet_index_counts[0], GL_UNSIGNED_SHORT, &meshlet_index_offsets[0], meshlet_index_counts.size(), &meshlet_base_vertices[0]);
+				}
+			}
+			else if (icosphere_indexed)
+			{
+				for (int i = 0; i < icosphere_chunks.chunks.size(); i++)
+				{
+					mesh_chunk& chunk = icosphere_chunks.chunks[i];
 
-			glDrawArrays(GL_TRIANGLES, 0, icosphere_managed_vertices.size());
+					glDrawElementsBaseVertex(GL_TRIANGLES, chunk.index_count, chunk.index_type, (void*)chunk.index_offset, chunk.base_vertex);
+				}
+			}
+			else
+			{
+				glDrawArrays(GL_TRIANGLES, 0, icosphere_vertex_count);
+			}
 
 			// Unbind the icosphere VAO from the current state.
 
 			glBindVertexArray(0);
 
+			// Draw the ocean, from the back faces of its cube.
+
+			if (icosphere_ocean)
+			{
+				glUseProgram(ocean_shader_program);
+
+				glActiveTexture(GL_TEXTURE0);
+
+				glBindTexture(GL_TEXTURE_2D, ocean_texture);
+
+				glCullFace(GL_FRONT);
+
+				glBindVertexArray(ocean_vao);
+
+				glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0);
+
+				glBindVertexArray(0);
+
+				glCullFace(GL_BACK);
+
+				glBindTexture(GL_TEXTURE_2D, 0);
+			}
+
 			// Disable backface culling.
 
 			glDisable(GL_CULL_FACE);
@@ -774,7 +8820,7 @@ int main(int argc, char** argv)
 
 			glDisable(GL_DEPTH_TEST);
 
-			// Disable the default shader program.
+			// Disable the icosphere's shader program.
 
 			glUseProgram(0);
 		}
@@ -783,13 +8829,84 @@ int main(int argc, char** argv)
 		// back buffer to the screen.
 
 		SDL_GL_SwapWindow(sdl_window);
+
+		// Show the frame rate and the amount of patches and triangles drawn
+		// in the window's title, once per second.
+
+		title_frames++;
+
+		if (ticks - title_ticks >= 1000)
+		{
+			std::stringstream title;
+
+			title << "Planet - " << title_frames * 1000 / (ticks - title_ticks) << " FPS";
+
+			if (icosphere_roam)
+			{
+				title << ", " << icosphere_roam_planet->get_triangle_count() << " triangles";
+			}
+			else if (icosphere_lod)
+			{
+				title << ", " << icosphere_planet_lod->get_drawn_patch_count() << " patches (" << icosphere_planet_lod->get_resident_patch_count() << " resident, " << icosphere_planet_lod->get_frustum_culled_patch_count() << " outside the frustum, " << icosphere_planet_lod->get_horizon_culled_patch_count() << " behind the horizon, " << icosphere_planet_lod->get_submerged_patch_count() << " under the ocean), " << icosphere_planet_lod->get_drawn_triangle_count() << " triangles";
+			}
+			else if (icosphere_meshlets)
+			{
+				title << ", " << meshlet_index_counts.size() << " of " << icosphere_chunks.chunks.size() << " meshlets (" << backfacing_meshlet_count << " facing away, " << frustum_culled_meshlet_count << " outside the frustum)";
+			}
+
+			SDL_SetWindowTitle(sdl_window, title.str().c_str());
+
+			title_ticks = ticks;
+
+			title_frames = 0;
+		}
+	}
+
+	// Destroy the planet_lod and the roam_planet.
+
+	delete icosphere_planet_lod;
+
+	delete icosphere_roam_planet;
+
+	// Free the icosphere's vertices, or unmap them if they were loaded from 
+	// the cache.
+
+	if (icosphere_cached)
+	{
+		unmap_file(icosphere_cache_file);
+	}
+	else
+	{
+		free(icosphere_vertices);
 	}
 
-	// Free the icosphere's vertices.
+	// Destroy the icosphere's VAO, VBO and EBO.
+
+	glDeleteVertexArrays(1, &icosphere_vao);
+
+	glDeleteBuffers(1, &icosphere_vbo);
+	glDeleteBuffers(1, &icosphere_ebo);
+
+	// Destroy the ocean's VAO, VBO, EBO and texture.
 
-	free(icosphere_vertices);
+	if (icosphere_ocean)
+	{
+		glDeleteVertexArrays(1, &ocean_vao);
+
+		glDeleteBuffers(1, &ocean_vbo);
+		glDeleteBuffers(1, &ocean_ebo);
+
+		glDeleteTextures(1, &ocean_texture);
+
+		glDeleteProgram(ocean_shader_program);
+	}
+
+	// Destroy the shader programs.
 
-	// Destroy the default shader program.
+	if (icosphere_shader_program != default_shader_program)
+	{
+		glDeleteProgram(icosphere_shader_program);
+	}
 
 	glDeleteProgram(default_shader_program);
 